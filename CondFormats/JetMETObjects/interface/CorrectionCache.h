@@ -0,0 +1,140 @@
+//
+// Bounded memo cache of corrections and uncertainties
+//
+// Entries are keyed by up to kMaxKey floats (an unsigned long, such as a
+// configuration id, takes two), compared bit by bit, so a hit returns
+// exactly what was stored for the same inputs. Inputs can be rounded to
+// fewer mantissa bits with quantize() before the lookup to trade
+// precision for hits. When full, the least recently used (kLRU)
+// or the oldest (kFIFO) entry is evicted. Lookups that hit don't
+// allocate. Not thread-safe: use one cache per corrector and thread.
+//
+#ifndef CorrectionCache_h
+#define CorrectionCache_h
+
+#include <cstring>
+#include <list>
+#include <ostream>
+#include <iostream>
+#include <unordered_map>
+#include <stdint.h>
+
+class CorrectionCache
+{
+  public:
+    enum Policy {kLRU,kFIFO};
+    enum {kMaxKey = 12};
+    //-------- Cache statistics ----------
+    struct Stats
+    {
+      Stats() : mHits(0), mMisses(0), mEvictions(0), mEntries(0) {}
+      double hitRate() const {return mHits+mMisses ? double(mHits)/(mHits+mMisses) : 0;}
+      unsigned long mHits;      // served from the cache
+      unsigned long mMisses;    // computed and inserted
+      unsigned long mEvictions; // entries dropped for capacity
+      unsigned long mEntries;   // entries currently held
+    };
+    //-------- Key of up to kMaxKey floats -----
+    class Key
+    {
+      public:
+        Key() : mSize(0) {}
+        void clear() {mSize = 0;}
+        void push_back(float fX) {std::memcpy(&mBits[mSize++],&fX,sizeof(float));}
+        void push_back(unsigned long fId) {mBits[mSize++] = uint32_t(fId); mBits[mSize++] = uint32_t(fId>>16>>16);}
+        unsigned size() const {return mSize;}
+        bool operator== (const Key& other) const
+        {return mSize == other.mSize && std::memcmp(mBits,other.mBits,mSize*sizeof(uint32_t)) == 0;}
+        size_t hash() const
+        {
+          size_t h = mSize;
+          for(unsigned i=0;i<mSize;i++)
+            h = (h ^ mBits[i]) * 1099511628211ull;
+          return h;
+        }
+      private:
+        uint32_t mBits[kMaxKey];
+        unsigned mSize;
+    };
+    //-------- Constructor ---------------
+    //-- fBits: mantissa bits kept by quantize(), 23 (all) for exact keys
+    CorrectionCache(unsigned fCapacity, Policy fPolicy = kLRU, unsigned fBits = 23) :
+      mCapacity(fCapacity), mPolicy(fPolicy), mMantissaBits(fBits > 23 ? 23 : fBits) {}
+    //-------- Member functions ----------
+    unsigned capacity() const {return mCapacity;}
+    Policy   policy()   const {return mPolicy;}
+    unsigned bits()     const {return mMantissaBits;}
+    bool     isExact()  const {return mMantissaBits == 23;}
+    //-- fX rounded to the nearest value with bits() mantissa bits
+    float quantize(float fX) const
+    {
+      if (mMantissaBits == 23)
+        return fX;
+      uint32_t u;
+      std::memcpy(&u,&fX,sizeof(float));
+      uint32_t drop = 23-mMantissaBits;
+      u = (u + (1u<<(drop-1))) & ~((1u<<drop)-1);
+      std::memcpy(&fX,&u,sizeof(float));
+      return fX;
+    }
+    bool find(const Key& fKey, float& fValue)
+    {
+      Index::iterator it = mIndex.find(fKey);
+      if (it == mIndex.end())
+        {
+          mStats.mMisses++;
+          return false;
+        }
+      if (mPolicy == kLRU)
+        mEntries.splice(mEntries.begin(),mEntries,it->second);
+      fValue = it->second->second;
+      mStats.mHits++;
+      return true;
+    }
+    void insert(const Key& fKey, float fValue)
+    {
+      if (mCapacity == 0 || mIndex.count(fKey))
+        return;
+      if (mEntries.size() >= mCapacity)
+        {
+          mIndex.erase(mEntries.back().first);
+          mEntries.pop_back();
+          mStats.mEvictions++;
+        }
+      mEntries.push_front(Entry(fKey,fValue));
+      mIndex[fKey] = mEntries.begin();
+    }
+    Stats stats() const
+    {
+      Stats s = mStats;
+      s.mEntries = mEntries.size();
+      return s;
+    }
+    void printStats(std::ostream& fOut = std::cout) const
+    {
+      Stats s = stats();
+      fOut<<"CorrectionCache ("<<(mPolicy == kLRU ? "LRU" : "FIFO")<<", capacity "<<mCapacity
+          <<", "<<mMantissaBits<<" bits): "<<s.mHits<<" hits, "<<s.mMisses<<" misses ("
+          <<100.*s.hitRate()<<"% hits), "<<s.mEvictions<<" evictions, "<<s.mEntries<<" entries"<<std::endl;
+    }
+    void clear()
+    {
+      mIndex.clear();
+      mEntries.clear();
+      mStats = Stats();
+    }
+
+  private:
+    typedef std::pair<Key,float> Entry;
+    struct Hash {size_t operator()(const Key& fKey) const {return fKey.hash();}};
+    typedef std::unordered_map<Key,std::list<Entry>::iterator,Hash> Index;
+    //-------- Member variables ----------
+    unsigned          mCapacity;
+    Policy            mPolicy;
+    unsigned          mMantissaBits;
+    std::list<Entry>  mEntries; // most recent (kLRU) or newest (kFIFO) first
+    Index             mIndex;
+    Stats             mStats;
+};
+
+#endif
@@ -6,12 +6,37 @@
 #ifndef FACTORIZED_JET_CORRECTOR_H
 #define FACTORIZED_JET_CORRECTOR_H
 
+#include <iostream>
+#include <memory>
+#include <ostream>
 #include <vector>
 #include <string>
+#include "CondFormats/JetMETObjects/interface/SimpleJetCorrector.h"
+#include "CondFormats/JetMETObjects/interface/CorrectionCache.h"
 
-class SimpleJetCorrector;
 class JetCorrectorParameters;
 
+//------------------------------------------------------------------------
+//--- N jets as structure of arrays for FactorizedJetCorrector::correct --
+//--- Fields a level doesn't need may be left 0. Rho and NPV are given ---
+//--- per event and broadcast to its jets: mEvent[i] is the event of -----
+//--- jet i, or with mEvent 0 all jets are of one event (mRho[0]). -------
+//------------------------------------------------------------------------
+struct JetBatch
+{
+  JetBatch() : mN(0),mJetPt(0),mJetEta(0),mJetPhi(0),mJetE(0),mJetEMF(0),mJetA(0),mRho(0),mNPV(0),mEvent(0) {}
+  unsigned        mN;      // number of jets
+  const float*    mJetPt;  // raw pt
+  const float*    mJetEta;
+  const float*    mJetPhi;
+  const float*    mJetE;   // raw energy
+  const float*    mJetEMF;
+  const float*    mJetA;
+  const float*    mRho;    // per event
+  const int*      mNPV;    // per event
+  const unsigned* mEvent;  // event of each jet, 0 for a single event
+};
+
 class FactorizedJetCorrector
 {
   public:
@@ -33,23 +58,99 @@ class FactorizedJetCorrector
     void setLepPy       (float fLepPy);
     void setLepPz       (float fLepPz);
     void setAddLepToJet (bool fAddLepToJet);
+    void setInterpolation(bool fInterpolation);
+    void setInversion(SimpleJetCorrector::InversionMode fMode);
+    //-- optional memo cache of getCorrection(), keyed on the variables the
+    //-- levels use and the settings: fCapacity entries (0 switches it
+    //-- off), evicted by fPolicy. With fBits 23 the keys are exact and the
+    //-- results bit-identical; with fewer mantissa bits the variables are
+    //-- first rounded to them, so jets within ~2^-fBits (relative) share
+    //-- one correction. Clones start without a cache. Not with L6SLB.
+    void setCache(unsigned fCapacity, CorrectionCache::Policy fPolicy = CorrectionCache::kLRU, unsigned fBits = 23);
+    CorrectionCache::Stats cacheStats() const;
     float getCorrection();
+    float getCorrectionAndDerivative(float& fDerivative);
+    //-- inverse of getCorrection(): the raw pt whose corrected pt is
+    //-- fPtCorr, with the other variables set as for getCorrection(). A
+    //-- JetE is that of the corrected jet and is scaled with the pt. The
+    //-- root of pt*C(pt) = fPtCorr is bracketed and refined by Newton
+    //-- steps to 1e-6 (relative), starting from the last ratio of raw to
+    //-- corrected pt found at the same eta (bins of 0.1).
+    float getRawPt(float fPtCorr);
     std::vector<float> getSubCorrections();
+    void getSubCorrections(float* fResult, unsigned fSize);
+    //-- stateless: corrects the jets of fJets level by level, scaling pt
+    //-- and E of each jet as getCorrection() does, and writes the total
+    //-- corrections (equal to getCorrection() of each jet) to fResult.
+    //-- The lepton variables of L6SLB are not supported.
+    void correct(const JetBatch& fJets, float* fResult) const;
+    //-- stateless getRawPt() of the jets of fJets, where mJetPt (and mJetE)
+    //-- hold the corrected pt (and E); fResult receives the raw pt
+    void getRawPt(const JetBatch& fJets, float* fResult) const;
+    //-- a corrector that shares the level correctors (parameter tables
+    //-- and formulas) of this one and copies only the settings and jet
+    //-- variables; owned by the caller. setInterpolation/setInversion on
+    //-- either one first give it its own copy of the levels.
+    FactorizedJetCorrector* clone() const;
+    //-- the calling thread's clone of this corrector, made on first use.
+    //-- The clones belong to this corrector: a setInterpolation/
+    //-- setInversion deletes them (the threads then take new ones), and
+    //-- so does its destructor. Don't call the set* methods or delete
+    //-- this corrector while threads use it.
+    FactorizedJetCorrector& threadLocal() const;
+    //-- the corrector of level i (in the order of the levels), shared
+    //-- with the clones
+    std::shared_ptr<const SimpleJetCorrector> levelCorrector(unsigned i) const;
+    //-- instrumentation, compiled in with JEC_INSTRUMENT (see
+    //-- SimpleJetCorrector.h): the chains computed (jets of correct()
+    //-- included, cache hits not) and their cycles, and per level the
+    //-- cycles of filling the variables and the counters of the level
+    //-- corrector, which are shared with the clones and count their calls
+    //-- too. Without it only the cache hits and the inversion counts are
+    //-- filled and mEnabled is false.
+    struct LevelStats
+    {
+      LevelStats() : mFillCycles(0) {}
+      std::string                   mLevel;      // level of the parameters
+      unsigned long long            mFillCycles; // fillVector, or columns of correct()
+      SimpleJetCorrector::CallStats mCorrector;
+    };
+    struct Stats
+    {
+      Stats() : mEnabled(false),mCalls(0),mCacheHits(0),mCycles(0) {}
+      bool                    mEnabled;     // compiled with JEC_INSTRUMENT
+      unsigned long           mCalls;       // chains computed
+      unsigned long           mCacheHits;   // getCorrection() served by the memo cache
+      unsigned long long      mCycles;      // in the chains
+      std::vector<LevelStats> mLevels;
+    };
+    Stats stats() const;
+    void resetStats();
+    void printStats(std::ostream& fOut = std::cout) const;
     
        
   private:
   //---- Member Functions ----  
-    FactorizedJetCorrector(const FactorizedJetCorrector&);
+    FactorizedJetCorrector(const FactorizedJetCorrector&); // shares mCorrectors, see clone()
     FactorizedJetCorrector& operator= (const FactorizedJetCorrector&);
+    SimpleJetCorrector& ownCorrector(unsigned i);
+    static unsigned long nextId();
+    void renewId();
     float getLepPt()    const;
     float getRelLepPt() const;
     float getPtRel()    const;
+    void subCorrections(float* fDerivative);
+    void resetVariables();
+    void setVariable(VarTypes fVarType, float fValue);
+    unsigned variableFlags() const;
+    void setVariableFlags(unsigned fFlags);
+    void initBuffers();
     std::string parseOption(const std::string& ss, const std::string& type);
     std::string removeSpaces(const std::string& ss);
     std::vector<std::string> parseLevels(const std::string& ss);
     void initCorrectors(const std::string& fLevels, const std::string& fFiles, const std::string& fOptions);
     void checkConsistency(const std::vector<std::string>& fLevels, const std::vector<std::string>& fTags);
-    std::vector<float> fillVector(std::vector<VarTypes> fVarTypes);
+    void fillVector(const std::vector<VarTypes>& fVarTypes, std::vector<float>& fResult);
     std::vector<VarTypes> mapping(const std::vector<std::string>& fNames);
     //---- Member Data ---------
     int   mNPV;
@@ -78,10 +179,26 @@ class FactorizedJetCorrector
     bool  mIsAddLepToJetset;
     std::vector<LevelTypes> mLevels;
     std::vector<std::vector<VarTypes> > mParTypes,mBinTypes; 
-    std::vector<SimpleJetCorrector*> mCorrectors;
-    //---- Cache ----
-    std::vector<std::vector<float> > vvx; // MV
-    std::vector<std::vector<float> > vvy; // MV
-    std::vector<float> factors; // MV
+    std::vector<std::shared_ptr<SimpleJetCorrector> > mCorrectors; // shared by the clones
+    unsigned long mId;  // identifies the configuration for threadLocal()
+    struct ThreadClones;
+    std::shared_ptr<ThreadClones> mThreadClones; // clones of threadLocal(), see there
+    //---- Buffers, sized once by initBuffers() ----
+    std::vector<std::vector<float> > vvx; // binning variables of each level
+    std::vector<std::vector<float> > vvy; // parameter variables of each level
+    std::vector<float> factors;           // subcorrections
+    //---- Memo cache of getCorrection(), see setCache() ----
+    std::vector<VarTypes> mCacheTypes;    // the variables the levels use
+    std::vector<float> mCacheX;
+    CorrectionCache::Key mCacheKey;
+    std::unique_ptr<CorrectionCache> mCache;
+    //---- Starting ratios of raw to corrected pt of getRawPt(), per eta ----
+    std::vector<float> mRawPtRatio;
+#ifdef JEC_INSTRUMENT
+    //---- Instrumentation, see stats() ----
+    JetCorrectionCounter mStatCalls;
+    JetCorrectionCounter mCycles;
+    std::vector<JetCorrectionCounter> mFillCycles; // per level
+#endif
 };
 #endif
@@ -0,0 +1,125 @@
+#ifndef FormulaEvaluator_h
+#define FormulaEvaluator_h
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+//------------------------------------------------------------------------
+//--- Compiles a TFormula-style expression of the JEC text files into ----
+//--- postfix code that is evaluated with doubles and no interpreter. ----
+//--- Grammar: numbers, parameters [i], variables x y z t, the operators -
+//--- + - * / ^ (right associative, binds tighter than unary minus) and --
+//--- the functions pow log log10 exp sqrt abs fabs sin cos tan atan -----
+//--- sinh cosh tanh max min, also with the TMath:: names. The functions -
+//--- are the same libm calls TFormula makes, and x^2 is computed as x*x -
+//--- like compiled code does, so the results agree bit for bit with -----
+//--- TFormula::Eval on the same (double) inputs. ------------------------
+//--- The standard formulas of the JEC levels are recognized and run -----
+//--- through hand-written kernels that give the same bits. --------------
+//------------------------------------------------------------------------
+class FormulaEvaluator
+{
+ public:
+  typedef double (*Kernel)(const double* fX, const float* fPar);
+  typedef void (*BatchKernel)(unsigned fN, const double* const* fX, const float* fPar, double* fResult);
+  //-------- Constructors --------------
+  FormulaEvaluator();
+  FormulaEvaluator(const std::string& fFormula, bool fUseKernels = true);
+  //-------- Member functions -----------
+  //-- fX holds x,y,z,t (as many as nVariables()), fPar the parameters
+  double evaluate(const double* fX, const float* fPar) const 
+  {
+    return (mKernel != 0) ? mKernel(fX,fPar) : run(fX,fPar);
+  }
+  //-- fN points with the same parameters: fX holds the variables in rows
+  //-- of fN values, fX[k*fN+i] is variable k of point i (at least one
+  //-- row, nVariables() are read); fResult receives the fN values, equal
+  //-- bit for bit to evaluate() of each point
+  void evaluate(unsigned fN, const double* fX, const float* fPar, double* fResult) const;
+  //-- value and derivative with respect to variable fVar (0-3 for x-t),
+  //-- by forward-mode differentiation (dual numbers) of the program; the
+  //-- value is the same as evaluate() gives
+  double evaluate(const double* fX, const float* fPar, unsigned fVar, double& fDerivative) const;
+  const std::string& formula() const {return mFormula;    }
+  unsigned nParameters()       const {return mNPar;       }
+  unsigned nVariables()        const {return mNVar;       }
+  bool isSpecialized()         const {return mKernel != 0;}
+  //-------- Limits -----------------------
+  static const unsigned kMaxStack = 32;
+
+ private:
+  //-------- Instructions ---------------
+  enum OpCode {kConst,kVar,kPar,kNeg,kAdd,kSub,kMul,kDiv,kPow,kSquare,kMax,kMin,
+               kLog,kLog10,kExp,kSqrt,kAbs,kSin,kCos,kTan,kAtan,kSinh,kCosh,kTanh};
+  struct Instruction
+  {
+    Instruction(OpCode fOp, unsigned fIndex = 0, double fValue = 0) : mOp(fOp),mIndex(fIndex),mValue(fValue) {}
+    OpCode   mOp;
+    unsigned mIndex; /// variable or parameter index
+    double   mValue; /// constant
+  };
+  //-------- Generic evaluation ---------
+  double run(const double* fX, const float* fPar) const;
+  //-------- Parser ---------------------
+  void parseSum(const char*& fPos);
+  void parseProduct(const char*& fPos);
+  void parseUnary(const char*& fPos);
+  void parsePower(const char*& fPos);
+  void parsePrimary(const char*& fPos);
+  void parseFunction(const std::string& fName, const char*& fPos);
+  void expect(const char*& fPos, char fChar);
+  void emit(const Instruction& fInstruction);
+  void error(const char* fPos, const std::string& fMessage) const;
+  //-------- Member variables -----------
+  std::string              mFormula;
+  std::vector<Instruction> mCode;  /// postfix program
+  Kernel                   mKernel; /// specialized kernel, 0 if none
+  BatchKernel              mBatchKernel; /// its loop over points
+  unsigned                 mNPar;  /// highest parameter index + 1
+  unsigned                 mNVar;  /// highest variable index + 1
+  unsigned                 mDepth; /// stack depth while compiling
+};
+
+//------------------------------------------------------------------------
+//--- Process-wide intern table of compiled formulas ---------------------
+//--- Formulas are keyed by their normalized text (blanks removed where --
+//--- they don't separate two names or numbers) and handed out as shared -
+//--- immutable evaluators, so each distinct formula is compiled once. ---
+//------------------------------------------------------------------------
+class FormulaEvaluatorRegistry
+{
+  public:
+    typedef std::shared_ptr<const FormulaEvaluator> Handle;
+    //-------- Cache statistics ----------
+    struct Stats
+    {
+      Stats() : mHits(0), mMisses(0), mEntries(0) {}
+      unsigned long mHits;    // compilations avoided
+      unsigned long mMisses;  // formulas compiled
+      unsigned long mEntries; // distinct formulas currently held
+    };
+    //-------- Member functions ----------
+    static FormulaEvaluatorRegistry& instance();
+    static std::string normalize(const std::string& fFormula);
+    Handle get(const std::string& fFormula, bool fUseKernels = true);
+    Stats  stats() const;
+    void   printStats(std::ostream& fOut = std::cout) const;
+    void   clear();
+
+  private:
+    typedef std::pair<std::string,bool> Key;
+    FormulaEvaluatorRegistry() {}
+    FormulaEvaluatorRegistry(const FormulaEvaluatorRegistry&);
+    FormulaEvaluatorRegistry& operator= (const FormulaEvaluatorRegistry&);
+    //-------- Member variables ----------
+    mutable std::mutex   mMutex;
+    std::map<Key,Handle> mEntries;
+    Stats                mStats;
+};
+
+#endif
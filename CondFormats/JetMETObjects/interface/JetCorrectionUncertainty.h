@@ -3,6 +3,7 @@
 
 #include <string>
 #include <vector>
+#include "CondFormats/JetMETObjects/interface/CorrectionCache.h"
 class SimpleJetCorrectionUncertainty;
 class JetCorrectorParameters;
 
@@ -25,6 +26,13 @@ class JetCorrectionUncertainty
     void setLepPz       (float fLepPz);
     void setAddLepToJet (bool fAddLepToJet) {mAddLepToJet = fAddLepToJet;}
     float getUncertainty(bool fDirection);
+    //-- optional memo cache of getUncertainty(), keyed on the variables
+    //-- and the direction: fCapacity entries (0 switches it off), evicted
+    //-- by fPolicy. With fBits 23 the results are bit-identical, with
+    //-- fewer mantissa bits the variables are rounded to them first.
+    //-- setParameters() empties it.
+    void setCache(unsigned fCapacity, CorrectionCache::Policy fPolicy = CorrectionCache::kLRU, unsigned fBits = 23);
+    CorrectionCache::Stats cacheStats() const;
 
  private:
   JetCorrectionUncertainty(const JetCorrectionUncertainty&);
@@ -50,6 +58,7 @@ class JetCorrectionUncertainty
   bool  mIsLepPyset;
   bool  mIsLepPzset;
   SimpleJetCorrectionUncertainty* mUncertainty;
+  CorrectionCache* mCache;
 };
 
 #endif
@@ -11,6 +11,8 @@
 #include <vector>
 #include <algorithm>
 #include <iostream>
+#include <map>
+#include <unordered_map>
 //#include "FWCore/Utilities/interface/Exception.h"
 #include <ostream>
 
@@ -26,7 +28,7 @@ class JetCorrectorParameters
       public:
         //-------- Constructors -------------- 
         Definitions() {}
-        Definitions(const std::vector<std::string>& fBinVar, const std::vector<std::string>& fParVar, const std::string& fFormula, bool fIsResponse); 
+        Definitions(const std::vector<std::string>& fBinVar, const std::vector<std::string>& fParVar, const std::string& fFormula, bool fIsResponse, const std::string& fLevel = ""); 
         Definitions(const std::string& fLine); 
         //-------- Member functions ----------
         unsigned nBinVar()                  const {return mBinVar.size(); }
@@ -46,62 +48,168 @@ class JetCorrectorParameters
         std::vector<std::string> mParVar;
         std::vector<std::string> mBinVar;
     };
+    //---------------- Span class ----------------------------------
+    //-- Non-owning view of a contiguous range of floats -----------
+    class Span 
+    {
+      public:
+        //-------- Constructors --------------
+        Span() : mData(0),mSize(0) {}
+        Span(const float* fData, unsigned fSize) : mData(fData),mSize(fSize) {}
+        //-------- Member functions ----------
+        const float* begin()                const {return mData;        }
+        const float* end()                  const {return mData+mSize;  }
+        unsigned size()                     const {return mSize;        }
+        bool empty()                        const {return mSize == 0;   }
+        float operator[](unsigned fIndex)   const {return mData[fIndex];}
+      private:
+        //-------- Member variables ----------
+        const float* mData;
+        unsigned     mSize;
+    };
     //---------------- Record class --------------------------------
     //-- Each Record holds the properties of a bin ----------------- 
+    //-- Records returned by record() are views into the packed ----
+    //-- tables of the parameters and are valid as long as these --
+    //-- are; records built from vectors or lines own their data. --
     class Record 
     {
       public:
         //-------- Constructors --------------
-        Record() : mNvar(0),mMin(0),mMax(0) {}
-        Record(unsigned fNvar, const std::vector<float>& fXMin, const std::vector<float>& fXMax, const std::vector<float>& fParameters) : mNvar(fNvar),mMin(fXMin),mMax(fXMax),mParameters(fParameters) {}
+        Record() : mNvar(0),mNpar(0),mMin(0),mMax(0),mPar(0) {}
+        Record(unsigned fNvar, const std::vector<float>& fXMin, const std::vector<float>& fXMax, const std::vector<float>& fParameters);
+        Record(unsigned fNvar, const float* fXMin, const float* fXMax, unsigned fNpar, const float* fParameters) : mNvar(fNvar),mNpar(fNpar),mMin(fXMin),mMax(fXMax),mPar(fParameters) {}
         Record(const std::string& fLine, unsigned fNvar);
+        Record(const Record& fOther);
+        Record& operator= (const Record& fOther);
         //-------- Member functions ----------
         float xMin(unsigned fVar)           const {return mMin[fVar];                 }
         float xMax(unsigned fVar)           const {return mMax[fVar];                 }
         float xMiddle(unsigned fVar)        const {return 0.5*(xMin(fVar)+xMax(fVar));}
-        float parameter(unsigned fIndex)    const {return mParameters[fIndex];        }
-        std::vector<float> parameters()     const {return mParameters;                }
-        unsigned nParameters()              const {return mParameters.size();         }
+        float parameter(unsigned fIndex)    const {return mPar[fIndex];               }
+        std::vector<float> parameters()     const {return std::vector<float>(mPar,mPar+mNpar);}
+        Span parameterSpan()                const {return Span(mPar,mNpar);           }
+        unsigned nVar()                     const {return mNvar;                      }
+        unsigned nParameters()              const {return mNpar;                      }
         int operator< (const Record& other) const {return xMin(0) < other.xMin(0);    }
       private:
+        //-------- Member functions ----------
+        void bind();
         //-------- Member variables ----------
         unsigned           mNvar;
-        std::vector<float> mMin;
-        std::vector<float> mMax;
-        std::vector<float> mParameters;
+        unsigned           mNpar;
+        const float*       mMin;
+        const float*       mMax;
+        const float*       mPar;
+        std::vector<float> mStorage; /// xMin[], xMax[], parameters[] when the record owns its data
     };
      
     //-------- Constructors --------------
-    JetCorrectorParameters() { valid_ = false;}
+    JetCorrectorParameters() : mNvar(0),mStride(0),mIndexType(kLinearScan) { valid_ = false;}
     JetCorrectorParameters(const std::string& fFile, const std::string& fSection = "");
     JetCorrectorParameters(const JetCorrectorParameters::Definitions& fDefinitions,
-			 const std::vector<JetCorrectorParameters::Record>& fRecords) 
-      : mDefinitions(fDefinitions),mRecords(fRecords) { valid_ = true;}
+			 const std::vector<JetCorrectorParameters::Record>& fRecords);
+    //-- Flat tables in bin order, e.g. the arrays written by the table
+    //-- generator: record i has the limits [i*nBinVar,(i+1)*nBinVar) of
+    //-- fXMin/fXMax and the parameters [fOffset[i],fOffset[i+1]).
+    JetCorrectorParameters(const JetCorrectorParameters::Definitions& fDefinitions, unsigned fNRecords,
+                         const float* fXMin, const float* fXMax, const unsigned* fOffset, const float* fParameters);
     //-------- Member functions ----------
-    const Record& record(unsigned fBin)                          const {return mRecords[fBin]; }
+    Record record(unsigned fBin)                                 const;
     const Definitions& definitions()                             const {return mDefinitions;   }
-    unsigned size()                                              const {return mRecords.size();}
+    unsigned size()                                              const {return mNParameters.size();}
+    //-------- Packed table access -------
+    float xMin(unsigned fBin, unsigned fVar)                     const {return mXMin[fBin*mNvar+fVar];}
+    float xMax(unsigned fBin, unsigned fVar)                     const {return mXMax[fBin*mNvar+fVar];}
+    unsigned nParameters(unsigned fBin)                          const {return mNParameters[fBin];    }
+    Span parameters(unsigned fBin)                               const {return Span(parameterData(fBin),mNParameters[fBin]);}
     unsigned size(unsigned fVar)                                 const;
     int binIndex(const std::vector<float>& fX)                   const;
     int neighbourBin(unsigned fIndex, unsigned fVar, bool fNext) const;
     std::vector<float> binCenters(unsigned fVar)                 const;
+    float binCenter(unsigned fBin, unsigned fVar)                const {return mCenters[fVar*size()+fBin];}
     void printScreen()                                           const;
     void printFile(const std::string& fFileName)                 const;
     bool isValid() const { return valid_; }
+    //-------- Binary format -------------
+    //-- The binary format holds all sections of a text file with the 
+    //-- definitions and the flat record arrays, and is read with mmap.
+    //-- Binary and text files are recognized by their first bytes, so 
+    //-- either can be given to the constructor above.
+    static const unsigned kBinaryVersion = 1;
+    static bool isBinaryFile(const std::string& fFile);
+    static void convertToBinary(const std::string& fTextFile, const std::string& fBinaryFile);
+    static void printBinaryFile(const std::string& fFileName, 
+                                const std::vector<std::string>& fSections,
+                                const std::vector<JetCorrectorParameters>& fParameters);
+    //-------- Multi-section files -------
+    //-- Reads the file once and builds the requested sections from the
+    //-- recorded line positions. An empty fSections reads all sections 
+    //-- and returns their names in file order.
+    static void getSections(const std::string& fFile, std::vector<std::string>& fSections);
+    static void readSections(const std::string& fFile, std::vector<std::string>& fSections,
+                             std::vector<JetCorrectorParameters>& fParameters);
 
   private:
+    //-------- Section index -------------
+    typedef std::pair<size_t,size_t> LineSpan; /// offset and length of a line
+    struct SectionIndex 
+    {
+      std::vector<std::string>                      names;       /// sections in file order
+      std::map<std::string,std::vector<LineSpan> >  lines;       /// lines of each section
+      std::string                                   lastSection; /// last header of the file
+    };
+    //-------- Lookup index types --------
+    //-- kGrid: the records tile a grid, the bin is computed directly 
+    //-- kSegments: irregular records, candidates per segment of var 0
+    enum IndexType {kLinearScan,kGrid,kSegments};
+    //-------- Member functions ----------
+    void fill(const std::string& fBuffer, const std::vector<LineSpan>& fLines, 
+              const std::string& fSection, const std::string& fLastSection);
+    static void readFile(const std::string& fFile, std::string& fBuffer);
+    static void readGzipFile(const std::string& fFile, std::string& fBuffer);
+    static void indexSections(const std::string& fBuffer, SectionIndex& fIndex, const std::string* fSection = 0);
+    static void readBinary(const std::string& fFile, std::vector<std::string>& fSections,
+                           std::vector<JetCorrectorParameters>& fParameters, bool fReadRecords = true);
+    void pack(const std::vector<float>& fXMin, const std::vector<float>& fXMax, 
+              const std::vector<unsigned>& fOffset, const std::vector<float>& fParameters, 
+              const std::vector<unsigned>& fOrder);
+    const float* parameterData(unsigned fBin)                    const {return mParameters.data()+fBin*mStride;}
+    void buildIndex();
+    bool buildGridIndex();
+    bool buildSegmentIndex();
+    void buildNeighbours();
+    bool contains(unsigned fBin, const std::vector<float>& fX)   const;
     //-------- Member variables ----------
     JetCorrectorParameters::Definitions         mDefinitions;
-    std::vector<JetCorrectorParameters::Record> mRecords;
+    //-------- Packed records ------------
+    unsigned                                    mNvar;        /// bin variables per record
+    unsigned                                    mStride;      /// parameter slots per record
+    std::vector<float>                          mXMin;        /// [bin*mNvar+var]
+    std::vector<float>                          mXMax;        /// [bin*mNvar+var]
+    std::vector<float>                          mParameters;  /// [bin*mStride+i], zero padded
+    std::vector<unsigned>                       mNParameters; /// parameters of each record
     bool                                        valid_; /// is this a valid set?
+    //-------- Lookup index --------------
+    IndexType                                   mIndexType;
+    std::vector<std::vector<float> >            mEdges;       /// sorted grid edges per bin variable
+    std::vector<int>                            mCells;       /// grid cell -> first matching record
+    std::vector<float>                          mSegEdges;    /// sorted segment edges of bin variable 0
+    std::vector<unsigned>                       mSegBegin;    /// segment -> first candidate in mSegRecords
+    std::vector<unsigned>                       mSegRecords;  /// candidate records in ascending order
+    //-------- Interpolation cache -------
+    std::vector<int>                            mNeighbours;  /// [(bin*nBinVar+var)*2+next] -> neighbour bin
+    std::vector<float>                          mCenters;     /// [var*size+bin] -> bin center
 };
 
 
-/*
 class JetCorrectorParametersCollection {
   //---------------- JetCorrectorParametersCollection class ----------------
   //-- Adds several JetCorrectorParameters together by algorithm type ---
   //--     to reduce the number of payloads in the Database ---
+  //-- The payloads are kept in one vector in insertion order; keys and ---
+  //-- labels (level names, L5/L7 species or section names such as ---
+  //-- uncertainty sources) are hashed to their position in it. ---
  public:
   enum Level_t { L1Offset=0,
 		 L1JPTOffset=7,
@@ -127,22 +235,31 @@ class JetCorrectorParametersCollection {
   typedef std::vector<pair_type>         collection_type;
 
 
-  // Constructor... initialize all three vectors to zero
-  JetCorrectorParametersCollection() { corrections_.clear(); correctionsL5_.clear(); correctionsL7_.clear(); }
+  // Constructor: an empty collection
+  JetCorrectorParametersCollection() {}
+
+  // Reads all sections of a file in a single pass and adds them under
+  // the level k, each labelled by its section name (e.g. the sources of 
+  // an UncertaintySources file).
+  JetCorrectorParametersCollection( std::string const & inputFile, key_type k = Uncertainty );
 
   // Add a JetCorrectorParameter object, possibly with flavor. 
+  // For levels other than L5/L7 a non-empty label names the payload,
+  // e.g. with its section name.
   void push_back( key_type i, value_type const & j, label_type const & flav = "" );
 
   // Access the JetCorrectorParameter via the key k.
   // key_type is hashed to deal with the three collections
   JetCorrectorParameters const & operator[]( key_type k ) const;
 
-  // Access the JetCorrectorParameter via a string. 
-  // Will find the hashed value for the label, and call via that 
-  // operator. 
-  JetCorrectorParameters const & operator[]( std::string const & label ) const {
-    return operator[]( findKey(label) );
-  }
+  // Access the JetCorrectorParameter via a string: a payload label
+  // (section name or L5/L7 species) or a level name.
+  JetCorrectorParameters const & operator[]( std::string const & label ) const;
+
+  // Is there a payload for this label or level name?
+  bool contains( std::string const & label ) const;
+
+  unsigned size() const { return corrections_.size(); }
 
   // Get a list of valid keys. These will contain hashed keys
   // that are aware of all three collections. 
@@ -182,14 +299,19 @@ class JetCorrectorParametersCollection {
       return l7Partons_[k / 1000 - 1];
   }
 
+  // Find the key corresponding to each label
+  key_type findKey( std::string const & label ) const;
+
  protected:
 
-  // Find the key corresponding to each label
-  //key_type findKey( std::string const & label ) const;
+  // Hashes the last payload by its key and label
+  void index( label_type const & label );
+  // Level names and L5/L7 species -> key
+  static const std::unordered_map<std::string,key_type> & levelKeys();
 
   collection_type                        corrections_;
-  collection_type                        correctionsL5_;
-  collection_type                        correctionsL7_;
+  std::unordered_map<key_type,unsigned>  keyIndex_;   /// key -> first payload with it
+  std::unordered_map<label_type,unsigned> labelIndex_; /// label -> payload
   static const char *                    labelsArray_[N_LEVELS];
   static std::vector<std::string>        labels_;
 
@@ -199,7 +321,6 @@ class JetCorrectorParametersCollection {
   static const char *                    l7PartonArray_[N_L7_SPECIES];
   static std::vector<std::string>        l7Partons_;
 };
-  */
 
 
 
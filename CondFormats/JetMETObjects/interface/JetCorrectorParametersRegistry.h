@@ -0,0 +1,57 @@
+//
+// Process-wide cache of parsed JetCorrectorParameters
+//
+// Entries are keyed by (file, section) and handed out as shared,
+// immutable objects. A cached parse is reused as long as the file's
+// modification time and size are unchanged; otherwise it is re-read.
+//
+#ifndef JetCorrectorParametersRegistry_h
+#define JetCorrectorParametersRegistry_h
+
+#include <string>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <iostream>
+#include <sys/types.h>
+#include "CondFormats/JetMETObjects/interface/JetCorrectorParameters.h"
+
+class JetCorrectorParametersRegistry
+{
+  public:
+    typedef std::shared_ptr<const JetCorrectorParameters> Handle;
+    //-------- Cache statistics ----------
+    struct Stats
+    {
+      Stats() : mHits(0), mMisses(0), mReloads(0), mEntries(0) {}
+      unsigned long mHits;    // served from the cache
+      unsigned long mMisses;  // parsed from file (includes reloads)
+      unsigned long mReloads; // cached entry was stale (mtime or size changed)
+      unsigned long mEntries; // (file, section) pairs currently held
+    };
+    //-------- Member functions ----------
+    static JetCorrectorParametersRegistry& instance();
+    Handle get(const std::string& fFile, const std::string& fSection = "");
+    Stats  stats() const;
+    void   printStats(std::ostream& fOut = std::cout) const;
+    void   clear();
+
+  private:
+    typedef std::pair<std::string,std::string> Key;
+    struct Entry
+    {
+      time_t mMTime;
+      off_t  mSize;
+      Handle mParameters;
+    };
+    JetCorrectorParametersRegistry() {}
+    JetCorrectorParametersRegistry(const JetCorrectorParametersRegistry&);
+    JetCorrectorParametersRegistry& operator= (const JetCorrectorParametersRegistry&);
+    //-------- Member variables ----------
+    mutable std::mutex  mMutex;
+    std::map<Key,Entry> mEntries;
+    Stats               mStats;
+};
+
+#endif
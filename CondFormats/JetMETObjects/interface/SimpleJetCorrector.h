@@ -1,17 +1,107 @@
 #ifndef SimpleJetCorrector_h
 #define SimpleJetCorrector_h
 
+#include <atomic>
 #include <string>
 #include <vector>
 
-#include <TFormula.h>
+#include "CondFormats/JetMETObjects/interface/FormulaEvaluator.h"
+
+//------------------------------------------------------------------------
+//--- Instrumentation: with JEC_INSTRUMENT defined (-DJEC_INSTRUMENT, ----
+//--- or gSystem->AddIncludePath("-DJEC_INSTRUMENT") before ACLiC) the ---
+//--- correctors count their calls and the cycles they spend in bin ------
+//--- search, formula evaluation and inversion, see callStats() and ------
+//--- FactorizedJetCorrector::printStats(). All files that include this --
+//--- header must agree on it. Without it the JEC_* macros expand to -----
+//--- nothing and the counters don't exist. With it every level adds a ---
+//--- few atomic adds and timestamp reads, which inflate the cycles: -----
+//--- compare the shares, not the totals. --------------------------------
+//------------------------------------------------------------------------
+#ifdef JEC_INSTRUMENT
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define JEC_TICKS() __rdtsc()
+#else
+#include <chrono>
+#define JEC_TICKS() std::chrono::steady_clock::now().time_since_epoch().count()
+#endif
+//--- a relaxed atomic counter, zero when made or copied
+class JetCorrectionCounter
+{
+  public:
+    JetCorrectionCounter() : mValue(0) {}
+    JetCorrectionCounter(const JetCorrectionCounter&) : mValue(0) {}
+    void add(unsigned long long fN) const {mValue.fetch_add(fN,std::memory_order_relaxed);}
+    unsigned long long value() const {return mValue.load(std::memory_order_relaxed);}
+    void reset() {mValue = 0;}
+  private:
+    JetCorrectionCounter& operator= (const JetCorrectionCounter&);
+    mutable std::atomic<unsigned long long> mValue;
+};
+//--- lap(c) adds the ticks since the start or the last lap to c
+class JetCorrectionTimer
+{
+  public:
+    JetCorrectionTimer() : mStart(JEC_TICKS()) {}
+    void lap(const JetCorrectionCounter& fCycles)
+    {
+      unsigned long long now = JEC_TICKS();
+      fCycles.add(now-mStart);
+      mStart = now;
+    }
+  private:
+    unsigned long long mStart;
+};
+#define JEC_COUNT(counter,n)   (counter).add(n)
+#define JEC_TIMER(timer)       JetCorrectionTimer timer
+#define JEC_LAP(timer,counter) (timer).lap(counter)
+#else
+#define JEC_COUNT(counter,n)
+#define JEC_TIMER(timer)
+#define JEC_LAP(timer,counter)
+#endif
 
 
 class JetCorrectorParameters;
 
+//------------------------------------------------------------------------
+//--- correction() is const and reentrant: the parameters are bound to ---
+//--- the bins when the corrector is made and the evaluator keeps no -----
+//--- state, so one corrector can serve many threads. The set* methods ---
+//--- are not, call them before the corrector is shared. -----------------
+//------------------------------------------------------------------------
 class SimpleJetCorrector 
 {
  public:
+  //-------- Response inversion ---------
+  //-- kFixedPoint: the original iteration pt/R, at most 50 evaluations
+  //-- kSafeguarded: bracketed secant (Illinois) on pt*R(pt) = ptraw
+  //-- kTabulated: as kSafeguarded, started from a bracket looked up in
+  //--   a per-bin table of pt*R(pt) (formulas of JetPt only)
+  enum InversionMode {kFixedPoint,kSafeguarded,kTabulated};
+  struct InversionStats
+  {
+    InversionStats() : mCalls(0),mEvaluations(0),mMaxEvaluations(0),mFailures(0) {}
+    unsigned long mCalls;          // inversions
+    unsigned long mEvaluations;    // formula evaluations in all inversions
+    unsigned long mMaxEvaluations; // most evaluations in one inversion
+    unsigned long mFailures;       // no bracket found, fixed point used
+  };
+  //-------- Instrumentation, see JEC_INSTRUMENT ---
+  //-- the inversion counts are those of inversionStats() and kept
+  //-- always, the rest is 0 without JEC_INSTRUMENT
+  struct CallStats
+  {
+    CallStats() : mCalls(0),mNoBin(0),mInversions(0),mEvaluations(0),mSearchCycles(0),mEvalCycles(0),mInvertCycles(0) {}
+    unsigned long      mCalls;        // jets corrected, one by one or in batches
+    unsigned long      mNoBin;        // jets in no bin, corrected by 1
+    unsigned long      mInversions;   // response inversions
+    unsigned long      mEvaluations;  // formula evaluations in them
+    unsigned long long mSearchCycles; // bin search, and grouping of batches by bin
+    unsigned long long mEvalCycles;   // formula evaluation and interpolation
+    unsigned long long mInvertCycles; // evaluation of response formulas, by inversion
+  };
   //-------- Constructors --------------
   SimpleJetCorrector();
   SimpleJetCorrector(const std::string& fDataFile, const std::string& fOption = "");
@@ -20,21 +110,73 @@ class SimpleJetCorrector
   ~SimpleJetCorrector();
   //-------- Member functions -----------
   void   setInterpolation(bool fInterpolation) {mDoInterpolation = fInterpolation;}
+  void   setInversion(InversionMode fMode);
+  bool   interpolation() const {return mDoInterpolation;}
+  InversionMode inversion() const {return mInversionMode;}
+  InversionStats inversionStats() const;
+  void   resetInversionStats();
+  CallStats callStats() const;
+  void   resetCallStats(); // and the inversion counts
   float  correction(const std::vector<float>& fX,const std::vector<float>& fY) const;  
+  //-- fN jets at once, structure of arrays: fX[k] and fY[k] hold the fN
+  //-- values of binning variable k and parameter variable k, fResult
+  //-- receives the fN corrections, equal to correction() of each jet
+  void   correction(unsigned fN, const float* const* fX, const float* const* fY, float* fResult) const;
+  //-- the correction and its derivative with respect to JetPt, 0 where
+  //-- the correction doesn't depend on it or JetPt is clamped to the range
+  float  correctionAndDerivative(const std::vector<float>& fX,const std::vector<float>& fY,float& fDerivative) const;
   const  JetCorrectorParameters& parameters() const {return *mParameters;} 
 
  private:
   //-------- Member functions -----------
   SimpleJetCorrector(const SimpleJetCorrector&);
   SimpleJetCorrector& operator= (const SimpleJetCorrector&);
-  float    invert(std::vector<float> fX) const;
-  float    correctionBin(unsigned fBin,const std::vector<float>& fY) const;
+  //-------- Per-bin parameter block ---
+  //-- bound once at load time: the ranges of the parameter variables and
+  //-- the formula parameters of the record, which are then read-only
+  struct Bin
+  {
+    double       mMin[4];
+    double       mMax[4];
+    const float* mPar;
+  };
+  float    invert(const float* fX, const float* fPar) const;
+  float    invertSafeguarded(const float* fX, const float* fPar, unsigned fBin) const;
+  double   residual(double* fX, double fPt, const float* fPar, unsigned& fNEval, double* fSlope = 0) const;
+  float    responseDerivative(const float* fX, const float* fPar, float fCorrection) const;
+  bool     tableBracket(unsigned fBin, double fTarget, double& fLow, double& fHigh,
+                        double& fResLow, double& fResHigh) const;
+  void     buildInverseTable();
+  void     countInversion(unsigned fNEval) const;
+  float    evaluateCorrection(const std::vector<float>& fX,const std::vector<float>& fY,float* fDerivative) const;
+  float    correctionBin(unsigned fBin,const std::vector<float>& fY,float* fDerivative = 0) const;
+  unsigned findVar(const std::string& fName) const;
   unsigned findInvertVar();
+  void     checkParameters() const;
+  void     bindParameters();
   //-------- Member variables -----------
   bool                    mDoInterpolation;
+  bool                    mIsResponse;
+  unsigned                mNParVar;
   unsigned                mInvertVar; 
-  TFormula*               mFunc;
+  unsigned                mPtVar;         /// JetPt among the parameter variables, 9999 if not
+  InversionMode           mInversionMode;
+  std::vector<double>     mInverseTable;  /// [(bin*kTableSize+i)*2] -> pt, +1 -> pt*R(pt)
+  std::vector<bool>       mInverseValid;  /// table of the bin is monotone
+  mutable std::atomic<unsigned long> mCalls;          /// InversionStats, counted
+  mutable std::atomic<unsigned long> mEvaluations;    /// from concurrent calls
+  mutable std::atomic<unsigned long> mMaxEvaluations;
+  mutable std::atomic<unsigned long> mFailures;
+  std::vector<Bin>        mBins;          /// one per record of mParameters
+  FormulaEvaluatorRegistry::Handle mFunc; /// shared with the correctors of the same formula
   JetCorrectorParameters* mParameters;
+#ifdef JEC_INSTRUMENT
+  JetCorrectionCounter    mStatCalls;     /// CallStats
+  JetCorrectionCounter    mStatNoBin;
+  JetCorrectionCounter    mSearchCycles;
+  JetCorrectionCounter    mEvalCycles;
+  JetCorrectionCounter    mInvertCycles;
+#endif
 };
 
 #endif
@@ -10,6 +10,12 @@
 #include "Math/PtEtaPhiE4D.h"
 #include "Math/Vector3D.h"
 #include "Math/LorentzVector.h"
+#include <atomic>
+#include <cmath>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
 #include <vector>
 #include <string>
 #include <sstream>
@@ -43,6 +49,7 @@ FactorizedJetCorrector::FactorizedJetCorrector()
   mIsLepPyset       = false;
   mIsLepPzset       = false;
   mIsAddLepToJetset = false;
+  renewId();
 }
 //------------------------------------------------------------------------ 
 //--- FactorizedJetCorrector constructor ---------------------------------
@@ -73,6 +80,7 @@ FactorizedJetCorrector::FactorizedJetCorrector(const std::string& fLevels, const
   mIsLepPyset       = false;
   mIsLepPzset       = false;
   mIsAddLepToJetset = false;
+  renewId();
   initCorrectors(fLevels, fFiles, fOptions);       
 }
 //------------------------------------------------------------------------
@@ -104,6 +112,7 @@ FactorizedJetCorrector::FactorizedJetCorrector(const std::vector<JetCorrectorPar
   mIsLepPyset       = false;
   mIsLepPzset       = false;
   mIsAddLepToJetset = false;
+  renewId();
   for(unsigned i=0;i<fParameters.size();i++)
     {
       std::string ss = fParameters[i].definitions().level();
@@ -125,10 +134,11 @@ FactorizedJetCorrector::FactorizedJetCorrector(const std::vector<JetCorrectorPar
         mLevels.push_back(kL7);
       else if (ss == "L1FastJet")
         mLevels.push_back(kL1fj);
-      mCorrectors.push_back(new SimpleJetCorrector(fParameters[i]));
+      mCorrectors.push_back(std::shared_ptr<SimpleJetCorrector>(new SimpleJetCorrector(fParameters[i])));
       mBinTypes.push_back(mapping(mCorrectors[i]->parameters().definitions().binVar()));
       mParTypes.push_back(mapping(mCorrectors[i]->parameters().definitions().parVar()));
-    }  
+    }
+  initBuffers();
 }
 
 //------------------------------------------------------------------------ 
@@ -136,8 +146,131 @@ FactorizedJetCorrector::FactorizedJetCorrector(const std::vector<JetCorrectorPar
 //------------------------------------------------------------------------
 FactorizedJetCorrector::~FactorizedJetCorrector()
 {
-  for(unsigned i=0;i<mCorrectors.size();i++)
-    delete mCorrectors[i];
+}
+//------------------------------------------------------------------------ 
+//--- FactorizedJetCorrector copy constructor, used by clone() -----------
+//--- The level correctors are shared, the rest is copied ----------------
+//------------------------------------------------------------------------
+FactorizedJetCorrector::FactorizedJetCorrector(const FactorizedJetCorrector& fOther) :
+  mNPV(fOther.mNPV),
+  mJetE(fOther.mJetE),
+  mJetEta(fOther.mJetEta),
+  mJetPt(fOther.mJetPt),
+  mJetPhi(fOther.mJetPhi),
+  mJetEMF(fOther.mJetEMF),
+  mJetA(fOther.mJetA),
+  mRho(fOther.mRho),
+  mLepPx(fOther.mLepPx),
+  mLepPy(fOther.mLepPy),
+  mLepPz(fOther.mLepPz),
+  mAddLepToJet(fOther.mAddLepToJet),
+  mIsNPVset(fOther.mIsNPVset),
+  mIsJetEset(fOther.mIsJetEset),
+  mIsJetPtset(fOther.mIsJetPtset),
+  mIsJetPhiset(fOther.mIsJetPhiset),
+  mIsJetEtaset(fOther.mIsJetEtaset),
+  mIsJetEMFset(fOther.mIsJetEMFset),
+  mIsJetAset(fOther.mIsJetAset),
+  mIsRhoset(fOther.mIsRhoset),
+  mIsLepPxset(fOther.mIsLepPxset),
+  mIsLepPyset(fOther.mIsLepPyset),
+  mIsLepPzset(fOther.mIsLepPzset),
+  mIsAddLepToJetset(fOther.mIsAddLepToJetset),
+  mLevels(fOther.mLevels),
+  mParTypes(fOther.mParTypes),
+  mBinTypes(fOther.mBinTypes),
+  mCorrectors(fOther.mCorrectors)
+{
+  renewId();
+  initBuffers();
+}
+//------------------------------------------------------------------------ 
+//--- Returns a new corrector sharing the level correctors ---------------
+//------------------------------------------------------------------------
+FactorizedJetCorrector* FactorizedJetCorrector::clone() const
+{
+  return new FactorizedJetCorrector(*this);
+}
+//------------------------------------------------------------------------ 
+//--- The clones made by threadLocal(), owned by their prototype --------
+//------------------------------------------------------------------------
+struct FactorizedJetCorrector::ThreadClones
+{
+  std::mutex mMutex;
+  std::vector<std::unique_ptr<FactorizedJetCorrector> > mClones;
+};
+//------------------------------------------------------------------------ 
+//--- Returns the clone of the calling thread, made on first use ---------
+//--- The clones belong to this corrector, which deletes them when its --
+//--- settings change or it is destroyed. A thread finds its clone by ---
+//--- mId, which is never reused, so it never finds a deleted clone; ----
+//--- the entries of deleted clones are dropped when it makes a new one --
+//------------------------------------------------------------------------
+FactorizedJetCorrector& FactorizedJetCorrector::threadLocal() const
+{
+  struct Entry
+  {
+    std::weak_ptr<ThreadClones> mOwner;
+    FactorizedJetCorrector*     mClone;
+  };
+  static thread_local std::unordered_map<unsigned long,Entry> clones;
+  std::unordered_map<unsigned long,Entry>::iterator it = clones.find(mId);
+  if (it!=clones.end())
+    return *it->second.mClone;
+  for(it=clones.begin();it!=clones.end();)
+    if (it->second.mOwner.expired())
+      it = clones.erase(it);
+    else
+      ++it;
+  FactorizedJetCorrector* c = clone();
+  {
+    std::lock_guard<std::mutex> lock(mThreadClones->mMutex);
+    mThreadClones->mClones.push_back(std::unique_ptr<FactorizedJetCorrector>(c));
+  }
+  Entry& e = clones[mId];
+  e.mOwner = mThreadClones;
+  e.mClone = c;
+  return *c;
+}
+//------------------------------------------------------------------------ 
+//--- Unique identifier of a corrector and its settings ------------------
+//------------------------------------------------------------------------
+unsigned long FactorizedJetCorrector::nextId()
+{
+  static std::atomic<unsigned long> id(0);
+  return ++id;
+}
+//------------------------------------------------------------------------ 
+//--- New settings: a new id, and the clones of threadLocal() dropped ---
+//------------------------------------------------------------------------
+void FactorizedJetCorrector::renewId()
+{
+  mId = nextId();
+  mThreadClones.reset(new ThreadClones());
+}
+//------------------------------------------------------------------------ 
+//--- Level corrector i, copied first if it is shared with a clone -------
+//------------------------------------------------------------------------
+SimpleJetCorrector& FactorizedJetCorrector::ownCorrector(unsigned i)
+{
+  if (mCorrectors[i].use_count() > 1)
+    {
+      const SimpleJetCorrector& shared = *mCorrectors[i];
+      std::shared_ptr<SimpleJetCorrector> own(new SimpleJetCorrector(shared.parameters()));
+      own->setInterpolation(shared.interpolation());
+      own->setInversion(shared.inversion());
+      mCorrectors[i] = own;
+    }
+  return *mCorrectors[i];
+}
+//------------------------------------------------------------------------ 
+//--- Level corrector i, as shared with the clones -----------------------
+//------------------------------------------------------------------------
+std::shared_ptr<const SimpleJetCorrector> FactorizedJetCorrector::levelCorrector(unsigned i) const
+{
+  if (i >= mCorrectors.size())
+    handleError("FactorizedJetCorrector","level index out of range");
+  return mCorrectors[i];
 }
 //------------------------------------------------------------------------ 
 //--- initialises the correctors -----------------------------------------
@@ -184,15 +317,15 @@ void FactorizedJetCorrector::initCorrectors(const std::string& fLevels, const st
   for(unsigned i=0;i<mLevels.size();i++)
     {     	    
       if (mLevels[i]==kL1 || mLevels[i]==kL2 || mLevels[i]==kL3 || mLevels[i]==kL4 || mLevels[i]==kL6 || mLevels[i]==kL1fj)
-        mCorrectors.push_back(new SimpleJetCorrector(Files[i])); 
+        mCorrectors.push_back(std::shared_ptr<SimpleJetCorrector>(new SimpleJetCorrector(Files[i])));
       else if (mLevels[i]==kL5 && FlavorOption.length()==0) 
         handleError("FactorizedJetCorrector","must specify flavor option when requesting L5Flavor correction!");
       else if (mLevels[i]==kL5 && FlavorOption.length()>0)
-        mCorrectors.push_back(new SimpleJetCorrector(Files[i],FlavorOption));
+        mCorrectors.push_back(std::shared_ptr<SimpleJetCorrector>(new SimpleJetCorrector(Files[i],FlavorOption)));
       else if (mLevels[i]==kL7 && PartonOption.length()==0) 
         handleError("FactorizedJetCorrector","must specify parton option when requesting L7Parton correction!");
       else if (mLevels[i]==kL7 && PartonOption.length()>0)
-        mCorrectors.push_back(new SimpleJetCorrector(Files[i],PartonOption));
+        mCorrectors.push_back(std::shared_ptr<SimpleJetCorrector>(new SimpleJetCorrector(Files[i],PartonOption)));
       else 
         {
           std::stringstream sserr; 
@@ -201,7 +334,8 @@ void FactorizedJetCorrector::initCorrectors(const std::string& fLevels, const st
 	}
       mBinTypes.push_back(mapping(mCorrectors[i]->parameters().definitions().binVar())); 
       mParTypes.push_back(mapping(mCorrectors[i]->parameters().definitions().parVar()));	
-    } 
+    }
+  initBuffers();
 }
 //------------------------------------------------------------------------ 
 //--- Mapping between variable names and variable types ------------------
@@ -336,13 +470,356 @@ std::string FactorizedJetCorrector::removeSpaces(const std::string& ss)
   return result; 
 }
 //------------------------------------------------------------------------ 
+//--- Smooth (interpolated) corrections for the L2 and L6 levels ---------
+//------------------------------------------------------------------------
+void FactorizedJetCorrector::setInterpolation(bool fInterpolation)
+{
+  renewId();
+  for(unsigned int i=0;i<mLevels.size();i++)
+    if ((mLevels[i]==kL2 || mLevels[i]==kL6) && mCorrectors[i]->interpolation()!=fInterpolation)
+      ownCorrector(i).setInterpolation(fInterpolation);
+}
+//------------------------------------------------------------------------ 
+//--- Inversion method for the levels given as a response ----------------
+//------------------------------------------------------------------------
+void FactorizedJetCorrector::setInversion(SimpleJetCorrector::InversionMode fMode)
+{
+  renewId();
+  for(unsigned int i=0;i<mCorrectors.size();i++)
+    if (mCorrectors[i]->inversion()!=fMode)
+      ownCorrector(i).setInversion(fMode);
+}
+//------------------------------------------------------------------------ 
 //--- Returns the correction ---------------------------------------------
 //------------------------------------------------------------------------
 float FactorizedJetCorrector::getCorrection()
 {
-  std::vector<float> vv = getSubCorrections();
-  //std::vector<float> const& vv = getSubCorrections();// MV
-  return vv[vv.size()-1];
+  if (!mCache)
+    {
+      subCorrections(0);
+      return factors[factors.size()-1];
+    }
+  //---- key: the variables, rounded to the cache precision, and the settings
+  fillVector(mCacheTypes,mCacheX);
+  mCacheKey.clear();
+  for(unsigned i=0;i<mCacheX.size();i++)
+    {
+      float x = mCache->quantize(mCacheX[i]);
+      if (x != mCacheX[i])
+        setVariable(mCacheTypes[i],x);
+      mCacheKey.push_back(x);
+    }
+  mCacheKey.push_back(mId);
+  float result;
+  if (mCache->find(mCacheKey,result))
+    {
+      resetVariables();
+      return result;
+    }
+  subCorrections(0);
+  result = factors[factors.size()-1];
+  mCache->insert(mCacheKey,result);
+  return result;
+}
+//------------------------------------------------------------------------ 
+//--- Returns the raw pt of the corrected pt fPtCorr ---------------------
+//--- pt*C(pt) rises with pt, so each evaluation narrows a bracket of ---
+//--- the root; Newton steps that leave it are replaced by bisections ---
+//--- (geometric) or, until both ends are known, by doubling/halving. ---
+//------------------------------------------------------------------------
+float FactorizedJetCorrector::getRawPt(float fPtCorr)
+{
+  const double tolerance = 1e-6;
+  if (!(fPtCorr>0))
+    {
+      std::stringstream sserr; 
+      sserr<<"corrected pt "<<fPtCorr<<" is not positive";
+      handleError("FactorizedJetCorrector",sserr.str());
+    }
+  //---- getCorrectionAndDerivative() unsets the variables, keep them
+  unsigned flags = variableFlags();
+  float eCorr = mJetE;
+  if (mRawPtRatio.empty())
+    mRawPtRatio.resize(104,1.);
+  int ieta = int((mJetEta+5.2)*10);
+  float& ratio = mRawPtRatio[ieta<0 ? 0 : ieta>103 ? 103 : ieta];
+  double pt = fPtCorr*ratio, lo = 0, hi = 0;
+  for(unsigned iter=0;iter<100;iter++)
+    {
+      setVariableFlags(flags);
+      setJetPt(pt);
+      if (mIsJetEset)
+        mJetE = eCorr*pt/fPtCorr;
+      float derivative;
+      float correction = getCorrectionAndDerivative(derivative);
+      double residual = pt*correction-fPtCorr, slope = correction+pt*derivative;
+      if (fabs(residual)<=tolerance*fPtCorr || (lo>0 && hi>0 && hi-lo<=tolerance*lo))
+        {
+          ratio = pt/fPtCorr;
+          return pt;
+        }
+      if (residual<0)
+        lo = pt;
+      else
+        hi = pt;
+      double next = slope>0 ? pt-residual/slope : 0;
+      if (lo>0 && hi>0)
+        {
+          if (!(next>lo && next<hi))
+            next = sqrt(lo*hi);
+        }
+      else if (lo>0)
+        {
+          if (!(next>lo))
+            next = 2*lo;
+        }
+      else if (!(next>0 && next<hi))
+        next = 0.5*hi;
+      pt = next;
+    }
+  std::stringstream sserr; 
+  sserr<<"no raw pt found for corrected pt "<<fPtCorr<<" at eta "<<mJetEta;
+  handleError("FactorizedJetCorrector",sserr.str());
+  return 0;
+}
+//------------------------------------------------------------------------ 
+//--- The set flags of the variables, as bits ----------------------------
+//------------------------------------------------------------------------
+unsigned FactorizedJetCorrector::variableFlags() const
+{
+  return mIsNPVset | mIsJetEset<<1 | mIsJetPtset<<2 | mIsJetPhiset<<3 | mIsJetEtaset<<4
+    | mIsJetEMFset<<5 | mIsJetAset<<6 | mIsRhoset<<7 | mIsLepPxset<<8 | mIsLepPyset<<9
+    | mIsLepPzset<<10 | mAddLepToJet<<11;
+}
+//------------------------------------------------------------------------ 
+void FactorizedJetCorrector::setVariableFlags(unsigned fFlags)
+{
+  mIsNPVset    = fFlags & 1;
+  mIsJetEset   = fFlags>>1 & 1;
+  mIsJetPtset  = fFlags>>2 & 1;
+  mIsJetPhiset = fFlags>>3 & 1;
+  mIsJetEtaset = fFlags>>4 & 1;
+  mIsJetEMFset = fFlags>>5 & 1;
+  mIsJetAset   = fFlags>>6 & 1;
+  mIsRhoset    = fFlags>>7 & 1;
+  mIsLepPxset  = fFlags>>8 & 1;
+  mIsLepPyset  = fFlags>>9 & 1;
+  mIsLepPzset  = fFlags>>10 & 1;
+  mAddLepToJet = fFlags>>11 & 1;
+}
+//------------------------------------------------------------------------ 
+//--- getRawPt() of a batch of jets --------------------------------------
+//--- All unconverged jets are corrected together with correct() each ---
+//--- round. A jet's next pt is the fixed point fPtCorr/C(pt) until ----
+//--- the root is bracketed, then the Illinois (regula falsi) point of --
+//--- the bracket. -------------------------------------------------------
+//------------------------------------------------------------------------
+void FactorizedJetCorrector::getRawPt(const JetBatch& fJets, float* fResult) const
+{
+  const double tolerance = 1e-6;
+  unsigned n = fJets.mN;
+  if (n == 0)
+    return;
+  if (!fJets.mJetPt)
+    handleError("FactorizedJetCorrector","jet pt is not set");
+  std::vector<unsigned> active(n),event;
+  std::vector<double> lo(n,0),hi(n,0),rlo(n,0),rhi(n,0);
+  std::vector<int> side(n,0);
+  for(unsigned i=0;i<n;i++)
+    {
+      active[i] = i;
+      if (!(fJets.mJetPt[i]>0))
+        {
+          std::stringstream sserr; 
+          sserr<<"corrected pt "<<fJets.mJetPt[i]<<" is not positive";
+          handleError("FactorizedJetCorrector",sserr.str());
+        }
+      fResult[i] = fJets.mJetPt[i];
+    }
+  std::vector<float> pt,eta,phi,e,emf,a,correction;
+  for(unsigned iter=0;iter<100 && !active.empty();iter++)
+    {
+      //---- the unconverged jets as a batch
+      unsigned m = active.size();
+      JetBatch sub;
+      sub.mN   = m;
+      sub.mRho = fJets.mRho;
+      sub.mNPV = fJets.mNPV;
+      pt.resize(m);
+      for(unsigned j=0;j<m;j++)
+        pt[j] = fResult[active[j]];
+      sub.mJetPt = &pt[0];
+      const float* columns[] = {fJets.mJetEta,fJets.mJetPhi,fJets.mJetEMF,fJets.mJetA};
+      std::vector<float>* gathered[] = {&eta,&phi,&emf,&a};
+      const float** fields[] = {&sub.mJetEta,&sub.mJetPhi,&sub.mJetEMF,&sub.mJetA};
+      for(unsigned k=0;k<4;k++)
+        if (columns[k])
+          {
+            gathered[k]->resize(m);
+            for(unsigned j=0;j<m;j++)
+              (*gathered[k])[j] = columns[k][active[j]];
+            *fields[k] = &(*gathered[k])[0];
+          }
+      if (fJets.mJetE)
+        {
+          e.resize(m);
+          for(unsigned j=0;j<m;j++)
+            e[j] = fJets.mJetE[active[j]]*pt[j]/fJets.mJetPt[active[j]];
+          sub.mJetE = &e[0];
+        }
+      if (fJets.mEvent)
+        {
+          event.resize(m);
+          for(unsigned j=0;j<m;j++)
+            event[j] = fJets.mEvent[active[j]];
+          sub.mEvent = &event[0];
+        }
+      correction.resize(m);
+      correct(sub,&correction[0]);
+      //---- next pt of each jet, the converged ones leave
+      unsigned left = 0;
+      for(unsigned j=0;j<m;j++)
+        {
+          unsigned i = active[j];
+          double target = fJets.mJetPt[i], p = pt[j];
+          double residual = p*correction[j]-target;
+          if (fabs(residual)<=tolerance*target || (lo[i]>0 && hi[i]>0 && hi[i]-lo[i]<=tolerance*lo[i]))
+            continue;
+          if (residual<0)
+            {
+              lo[i] = p;
+              rlo[i] = residual;
+              if (side[i]==-1)
+                rhi[i] *= 0.5;
+              side[i] = -1;
+            }
+          else
+            {
+              hi[i] = p;
+              rhi[i] = residual;
+              if (side[i]==1)
+                rlo[i] *= 0.5;
+              side[i] = 1;
+            }
+          double next = target/correction[j];
+          if (lo[i]>0 && hi[i]>0)
+            next = lo[i]-rlo[i]*(hi[i]-lo[i])/(rhi[i]-rlo[i]);
+          if (!(next>0))
+            next = lo[i]>0 ? 2*lo[i] : 0.5*hi[i];
+          fResult[i] = next;
+          active[left++] = i;
+        }
+      active.resize(left);
+    }
+  if (!active.empty())
+    {
+      std::stringstream sserr; 
+      sserr<<"no raw pt found for corrected pt "<<fJets.mJetPt[active[0]];
+      handleError("FactorizedJetCorrector",sserr.str());
+    }
+}
+//------------------------------------------------------------------------ 
+//--- Memo cache of getCorrection() --------------------------------------
+//------------------------------------------------------------------------
+void FactorizedJetCorrector::setCache(unsigned fCapacity, CorrectionCache::Policy fPolicy, unsigned fBits)
+{
+  mCache.reset();
+  if (fCapacity == 0)
+    return;
+  for(unsigned i=0;i<mLevels.size();i++)
+    if (mLevels[i]==kL6)
+      handleError("FactorizedJetCorrector","the cache doesn't support L6SLB");
+  if (mCacheTypes.size()+2 > CorrectionCache::kMaxKey)
+    handleError("FactorizedJetCorrector","too many variables for the cache");
+  mCache.reset(new CorrectionCache(fCapacity,fPolicy,fBits));
+}
+//------------------------------------------------------------------------ 
+CorrectionCache::Stats FactorizedJetCorrector::cacheStats() const
+{
+  return mCache ? mCache->stats() : CorrectionCache::Stats();
+}
+//------------------------------------------------------------------------ 
+//--- Calls and cycles, see JEC_INSTRUMENT -------------------------------
+//------------------------------------------------------------------------
+FactorizedJetCorrector::Stats FactorizedJetCorrector::stats() const
+{
+  Stats result;
+  result.mCacheHits = cacheStats().mHits;
+#ifdef JEC_INSTRUMENT
+  result.mEnabled = true;
+  result.mCalls   = mStatCalls.value();
+  result.mCycles  = mCycles.value();
+#endif
+  result.mLevels.resize(mLevels.size());
+  for(unsigned i=0;i<mLevels.size();i++)
+    {
+      LevelStats& level = result.mLevels[i];
+      level.mLevel     = mCorrectors[i]->parameters().definitions().level();
+      level.mCorrector = mCorrectors[i]->callStats();
+#ifdef JEC_INSTRUMENT
+      level.mFillCycles = mFillCycles[i].value();
+#endif
+    }
+  return result;
+}
+//------------------------------------------------------------------------ 
+//--- Also resets the level counters, which the clones share -------------
+//------------------------------------------------------------------------
+void FactorizedJetCorrector::resetStats()
+{
+  for(unsigned i=0;i<mCorrectors.size();i++)
+    mCorrectors[i]->resetCallStats();
+#ifdef JEC_INSTRUMENT
+  mStatCalls.reset();
+  mCycles.reset();
+  for(unsigned i=0;i<mFillCycles.size();i++)
+    mFillCycles[i].reset();
+#endif
+}
+//------------------------------------------------------------------------ 
+//--- Prints the counters, the cycles as shares of those of the chains ---
+//------------------------------------------------------------------------
+void FactorizedJetCorrector::printStats(std::ostream& fOut) const
+{
+  Stats s = stats();
+  if (!s.mEnabled)
+    {
+      fOut<<"FactorizedJetCorrector: instrumentation not compiled in (JEC_INSTRUMENT), "
+          <<s.mCacheHits<<" cache hits"<<std::endl;
+      return;
+    }
+  std::ios::fmtflags flags = fOut.flags();
+  std::streamsize precision = fOut.precision();
+  double total = s.mCycles ? double(s.mCycles) : 1.;
+  fOut<<std::fixed<<std::setprecision(1);
+  fOut<<"FactorizedJetCorrector: "<<s.mCalls<<" corrections, "
+      <<(s.mCalls ? s.mCycles/double(s.mCalls) : 0.)<<" cycles each, "
+      <<s.mCacheHits<<" cache hits"<<std::endl;
+  fOut<<"  "<<std::setw(14)<<std::left<<"level"<<std::right
+      <<std::setw(11)<<"calls"<<std::setw(9)<<"no bin"<<std::setw(11)<<"inversions"
+      <<std::setw(10)<<"evals/inv"<<std::setw(8)<<"fill%"<<std::setw(9)<<"search%"
+      <<std::setw(8)<<"eval%"<<std::setw(9)<<"invert%"<<std::endl;
+  for(unsigned i=0;i<s.mLevels.size();i++)
+    {
+      const LevelStats& level = s.mLevels[i];
+      const SimpleJetCorrector::CallStats& c = level.mCorrector;
+      fOut<<"  "<<std::setw(14)<<std::left<<level.mLevel<<std::right
+          <<std::setw(11)<<c.mCalls<<std::setw(9)<<c.mNoBin<<std::setw(11)<<c.mInversions
+          <<std::setw(10)<<(c.mInversions ? c.mEvaluations/double(c.mInversions) : 0.)
+          <<std::setw(8)<<100.*level.mFillCycles/total<<std::setw(9)<<100.*c.mSearchCycles/total
+          <<std::setw(8)<<100.*c.mEvalCycles/total<<std::setw(9)<<100.*c.mInvertCycles/total<<std::endl;
+    }
+  fOut.flags(flags);
+  fOut.precision(precision);
+}
+//------------------------------------------------------------------------ 
+//--- Returns the correction and its derivative with respect to the ------
+//--- (raw) jet pt -------------------------------------------------------
+//------------------------------------------------------------------------
+float FactorizedJetCorrector::getCorrectionAndDerivative(float& fDerivative)
+{
+  subCorrections(&fDerivative);
+  return factors[factors.size()-1];
 }
 //------------------------------------------------------------------------ 
 //--- Returns the vector of subcorrections, up to a given level ----------
@@ -350,28 +827,74 @@ float FactorizedJetCorrector::getCorrection()
 //std::vector<float> const& FactorizedJetCorrector::getSubCorrections()
 std::vector<float> FactorizedJetCorrector::getSubCorrections()
 {
-  float scale,factor;
-  //std::vector<float> factors;
-  std::vector<float> vx,vy;
-  if (factors.size()==0) factors.resize(mLevels.size()); // MV
+  subCorrections(0);
+  return factors;
+}
+//------------------------------------------------------------------------ 
+//--- Writes the subcorrections to fResult, which holds fSize floats -----
+//--- (at least one per level); no allocation ----------------------------
+//------------------------------------------------------------------------
+void FactorizedJetCorrector::getSubCorrections(float* fResult, unsigned fSize)
+{
+  if (fSize < mLevels.size())
+    {
+      std::stringstream sserr; 
+      sserr<<"room for "<<fSize<<" subcorrections, "<<mLevels.size()<<" levels";
+      handleError("FactorizedJetCorrector",sserr.str());
+    }
+  subCorrections(0);
+  for(unsigned i=0;i<factors.size();i++)
+    fResult[i] = factors[i];
+}
+//------------------------------------------------------------------------ 
+//--- Returns the subcorrections, and the derivative of the total --------
+//--- correction if fDerivative is given. Each level sees the pt --------
+//--- corrected by the levels before, pt_i+1 = pt_i*c_i(pt_i), so -------
+//--- dpt_i+1/dpt = (c_i + pt_i*c_i')*dpt_i/dpt and the total C = --------
+//--- pt_n/pt has dC/dpt = (dpt_n/dpt - C)/pt. The other variables, ------
+//--- also the scaled JetE, are held fixed. ------------------------------
+//--- The variables are written into the per-level buffers vvx, vvy and --
+//--- the results into factors, all sized by initBuffers(), so nothing ---
+//--- is allocated here. -------------------------------------------------
+//------------------------------------------------------------------------
+void FactorizedJetCorrector::subCorrections(float* fDerivative)
+{
+  float scale,factor,derivative;
+  double rawPt = mJetPt, dPt = 1.;
   factor = 1;
+  JEC_TIMER(total);
+  JEC_COUNT(mStatCalls,1);
   for(unsigned int i=0;i<mLevels.size();i++)
     { 
-      vx = fillVector(mBinTypes[i]);
-      vy = fillVector(mParTypes[i]);
-      //if (vvx.size()==i) vvx.push_back(fillVector(mBinTypes[i])); // MV
-      //if (vvy.size()==i) vvy.push_back(fillVector(mParTypes[i])); // MV
-      //if (mLevels[i]==kL2 || mLevels[i]==kL6)
-        //mCorrectors[i]->setInterpolation(true); 
-      scale = mCorrectors[i]->correction(vx,vy); 	
-      //scale = mCorrectors[i]->correction(vvx[i],vvy[i]); // MV
+      std::vector<float>& vx = vvx[i];
+      std::vector<float>& vy = vvy[i];
+      JEC_TIMER(timer);
+      fillVector(mBinTypes[i],vx);
+      fillVector(mParTypes[i],vy);
+      JEC_LAP(timer,mFillCycles[i]);
+      if (fDerivative)
+        {
+          scale = mCorrectors[i]->correctionAndDerivative(vx,vy,derivative);
+          dPt *= scale + mJetPt*derivative;
+        }
+      else
+        scale = mCorrectors[i]->correction(vx,vy); 	
       if (mLevels[i]==kL6 && mAddLepToJet) scale *= 1.0 + getLepPt() / mJetPt;
       factor*=scale; 
-      //factors.push_back(factor);	
-      factors[i] = factor; // MV
+      factors[i] = factor;
       mJetE *=scale;
       mJetPt*=scale;
     }
+  if (fDerivative)
+    *fDerivative = (dPt - factor)/rawPt;
+  JEC_LAP(total,mCycles);
+  resetVariables();
+}
+//------------------------------------------------------------------------ 
+//--- The variables have to be set again for the next jet ----------------
+//------------------------------------------------------------------------
+void FactorizedJetCorrector::resetVariables()
+{
   mIsNPVset    = false;
   mIsJetEset   = false;
   mIsJetPtset  = false;
@@ -384,76 +907,199 @@ std::vector<float> FactorizedJetCorrector::getSubCorrections()
   mIsLepPyset  = false;
   mIsLepPzset  = false;
   mAddLepToJet = false;
-  return factors; 
 }
 //------------------------------------------------------------------------ 
-//--- Reads the parameter names and fills a vector of floats -------------
+//--- Corrects a batch of jets -------------------------------------------
+//--- Each level corrects all jets with one SimpleJetCorrector batch -----
+//--- call, on columns of the batch: pt and E are running copies that ----
+//--- are scaled after every level, rho and NPV are broadcast from the ---
+//--- events to the jets once. -------------------------------------------
+//------------------------------------------------------------------------
+void FactorizedJetCorrector::correct(const JetBatch& fJets, float* fResult) const
+{
+  unsigned n = fJets.mN;
+  if (n == 0)
+    return;
+  if (!fJets.mJetPt)
+    handleError("FactorizedJetCorrector","jet pt is not set");
+  JEC_TIMER(total);
+  JEC_COUNT(mStatCalls,n);
+  std::vector<float> pt(fJets.mJetPt,fJets.mJetPt+n),e,rho,npv,scale(n);
+  if (fJets.mJetE)
+    e.assign(fJets.mJetE,fJets.mJetE+n);
+  if (fJets.mRho)
+    {
+      rho.resize(n);
+      for(unsigned i=0;i<n;i++)
+        rho[i] = fJets.mRho[fJets.mEvent ? fJets.mEvent[i] : 0];
+    }
+  if (fJets.mNPV)
+    {
+      npv.resize(n);
+      for(unsigned i=0;i<n;i++)
+        npv[i] = fJets.mNPV[fJets.mEvent ? fJets.mEvent[i] : 0];
+    }
+  for(unsigned i=0;i<n;i++)
+    fResult[i] = 1;
+  std::vector<const float*> vx,vy;
+  for(unsigned i=0;i<mLevels.size();i++)
+    {
+      if (mLevels[i]==kL6)
+        handleError("FactorizedJetCorrector","L6SLB is not supported for batches of jets");
+      JEC_TIMER(timer);
+      for(int k=0;k<2;k++)
+        {
+          const std::vector<VarTypes>& types = (k==0) ? mBinTypes[i] : mParTypes[i];
+          std::vector<const float*>& columns = (k==0) ? vx : vy;
+          columns.clear();
+          for(unsigned j=0;j<types.size();j++)
+            {
+              const float* column = 0;
+              const char* name = "";
+              switch (types[j])
+                {
+                  case kJetPt:  column = &pt[0];                      name = "jet pt";                          break;
+                  case kJetEta: column = fJets.mJetEta;               name = "jet eta";                         break;
+                  case kJetPhi: column = fJets.mJetPhi;               name = "jet phi";                         break;
+                  case kJetE:   column = e.empty() ? 0 : &e[0];       name = "jet E";                           break;
+                  case kJetEMF: column = fJets.mJetEMF;               name = "jet EMF";                         break;
+                  case kJetA:   column = fJets.mJetA;                 name = "jet area";                        break;
+                  case kRho:    column = rho.empty() ? 0 : &rho[0];   name = "fastjet density Rho";             break;
+                  case kNPV:    column = npv.empty() ? 0 : &npv[0];   name = "number of primary vertices";      break;
+                  default:
+                    handleError("FactorizedJetCorrector","lepton variables are not supported for batches of jets");
+                }
+              if (!column)
+                handleError("FactorizedJetCorrector",std::string(name)+" is not set");
+              columns.push_back(column);
+            }
+        }
+      JEC_LAP(timer,mFillCycles[i]);
+      mCorrectors[i]->correction(n,vx.empty() ? 0 : &vx[0],vy.empty() ? 0 : &vy[0],&scale[0]);
+      for(unsigned j=0;j<n;j++)
+        {
+          fResult[j]*=scale[j];
+          pt[j]*=scale[j];
+        }
+      if (!e.empty())
+        for(unsigned j=0;j<n;j++)
+          e[j]*=scale[j];
+    }
+  JEC_LAP(total,mCycles);
+}
+//------------------------------------------------------------------------ 
+//--- Sizes the buffers of the variables and subcorrections once ---------
+//------------------------------------------------------------------------
+void FactorizedJetCorrector::initBuffers()
+{
+  vvx.resize(mLevels.size());
+  vvy.resize(mLevels.size());
+  for(unsigned i=0;i<mLevels.size();i++)
+    {
+      vvx[i].resize(mBinTypes[i].size());
+      vvy[i].resize(mParTypes[i].size());
+    }
+  factors.resize(mLevels.size());
+  mCacheTypes.clear();
+  for(unsigned i=0;i<mLevels.size();i++)
+    for(unsigned k=0;k<mBinTypes[i].size()+mParTypes[i].size();k++)
+      {
+        VarTypes type = k<mBinTypes[i].size() ? mBinTypes[i][k] : mParTypes[i][k-mBinTypes[i].size()];
+        if (std::find(mCacheTypes.begin(),mCacheTypes.end(),type)==mCacheTypes.end())
+          mCacheTypes.push_back(type);
+      }
+  mCacheX.resize(mCacheTypes.size());
+#ifdef JEC_INSTRUMENT
+  mFillCycles.resize(mLevels.size());
+#endif
+}
+//------------------------------------------------------------------------ 
+//--- Sets a variable to a value rounded for the cache -------------------
+//------------------------------------------------------------------------
+void FactorizedJetCorrector::setVariable(VarTypes fVarType, float fValue)
+{
+  switch (fVarType)
+    {
+      case kJetPt:  mJetPt  = fValue; break;
+      case kJetEta: mJetEta = fValue; break;
+      case kJetPhi: mJetPhi = fValue; break;
+      case kJetE:   mJetE   = fValue; break;
+      case kJetEMF: mJetEMF = fValue; break;
+      case kNPV:    mNPV    = int(fValue+0.5); break;
+      case kJetA:   mJetA   = fValue; break;
+      case kRho:    mRho    = fValue; break;
+      default:
+        handleError("FactorizedJetCorrector","the cache doesn't support the lepton variables");
+    }
+}
+//------------------------------------------------------------------------ 
+//--- Fills the variables of the given types into fResult, which has -----
+//--- one element per type -----------------------------------------------
 //------------------------------------------------------------------------
-std::vector<float> FactorizedJetCorrector::fillVector(std::vector<VarTypes> fVarTypes)
+void FactorizedJetCorrector::fillVector(const std::vector<VarTypes>& fVarTypes, std::vector<float>& fResult)
 {
-  std::vector<float> result;
   for(unsigned i=0;i<fVarTypes.size();i++) 
     {
       if (fVarTypes[i] == kJetEta)
         {
           if (!mIsJetEtaset) 
             handleError("FactorizedJetCorrector","jet eta is not set");
-          result.push_back(mJetEta);
+          fResult[i] = mJetEta;
         }
       else if (fVarTypes[i] == kNPV)
         {
           if (!mIsNPVset)
             handleError("FactorizedJetCorrector","number of primary vertices is not set");
-          result.push_back(mNPV);
+          fResult[i] = mNPV;
         }
       else if (fVarTypes[i] == kJetPt) 
         {
           if (!mIsJetPtset)
             handleError("FactorizedJetCorrector","jet pt is not set");
-          result.push_back(mJetPt);
+          fResult[i] = mJetPt;
         }
       else if (fVarTypes[i] == kJetPhi) 
         {
           if (!mIsJetPhiset) 
             handleError("FactorizedJetCorrector","jet phi is not set");
-          result.push_back(mJetPhi);
+          fResult[i] = mJetPhi;
         }
       else if (fVarTypes[i] == kJetE) 
         {
           if (!mIsJetEset) 
             handleError("FactorizedJetCorrector","jet E is not set");
-          result.push_back(mJetE);
+          fResult[i] = mJetE;
         }
       else if (fVarTypes[i] == kJetEMF) 
         {
           if (!mIsJetEMFset) 
             handleError("FactorizedJetCorrector","jet EMF is not set");
-          result.push_back(mJetEMF);
+          fResult[i] = mJetEMF;
         } 
       else if (fVarTypes[i] == kJetA) 
         {
           if (!mIsJetAset) 
             handleError("FactorizedJetCorrector","jet area is not set");
-          result.push_back(mJetA);
+          fResult[i] = mJetA;
         }
       else if (fVarTypes[i] == kRho) 
         {
           if (!mIsRhoset) 
             handleError("FactorizedJetCorrector","fastjet density Rho is not set");
-          result.push_back(mRho);
+          fResult[i] = mRho;
         }
       else if (fVarTypes[i] == kRelLepPt) 
         {
           if (!mIsJetPtset||!mIsAddLepToJetset||!mIsLepPxset||!mIsLepPyset) 
             handleError("FactorizedJetCorrector","can't calculate rel lepton pt");
-          result.push_back(getRelLepPt());
+          fResult[i] = getRelLepPt();
         }
       else if (fVarTypes[i] == kPtRel) 
         {
           if (!mIsJetPtset||!mIsJetEtaset||!mIsJetPhiset||!mIsJetEset||
 	      !mIsAddLepToJetset||!mIsLepPxset||!mIsLepPyset||!mIsLepPzset) 
             handleError("FactorizedJetCorrector","can't calculate ptrel");
-          result.push_back(getPtRel());
+          fResult[i] = getPtRel();
         }
       else 
         {
@@ -462,7 +1108,6 @@ std::vector<float> FactorizedJetCorrector::fillVector(std::vector<VarTypes> fVar
           handleError("FactorizedJetCorrector",sserr.str());
         }
     }
-  return result;      
 }
 //------------------------------------------------------------------------ 
 //--- Calculate the lepPt (needed for the SLB) ---------------------------
@@ -0,0 +1,627 @@
+#include "CondFormats/JetMETObjects/interface/FormulaEvaluator.h"
+#include "CondFormats/JetMETObjects/src/Utilities.cc"
+#include <cctype>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <sstream>
+
+//------------------------------------------------------------------------
+//--- No contraction of a*b+c into fused multiply-adds in this file: -----
+//--- the kernels and the postfix program must round every operation -----
+//--- alike to stay bitwise equal, and gcc in GNU mode (the default) -----
+//--- or with -march=native would fuse the kernels' operations only. -----
+//--- Restored at the end, for the files that include this one. ----------
+//------------------------------------------------------------------------
+#if defined(__clang__)
+#pragma STDC FP_CONTRACT OFF
+#elif defined(__GNUC__)
+#pragma GCC push_options
+#pragma GCC optimize ("fp-contract=off")
+#endif
+
+namespace
+{
+  //------------------------------------------------------------------------
+  //--- Kernels for the standard formulas of the JEC levels ----------------
+  //--- Each repeats the operations of the postfix program in the same -----
+  //--- order and in double precision, so the results are bitwise equal. ---
+  //------------------------------------------------------------------------
+  inline double maxTMath(double a, double b) {return (a > b) ? a : b;}
+  //---- L1FastJet
+  struct L1FastJetKernel 
+  {
+    static const char* formula() {return "max(0.0001,1-y*([0]+([1]*z)*(1+[2]*log(x)))/x)";}
+    static double evaluate(const double* fX, const float* fPar)
+    {
+      double x = fX[0], y = fX[1], z = fX[2];
+      double p0 = fPar[0], p1 = fPar[1], p2 = fPar[2];
+      return maxTMath(0.0001,1-y*(p0+(p1*z)*(1+p2*log(x)))/x);
+    }
+  };
+  //---- L1FastJet with a rho polynomial 
+  struct L1FastJetRhoKernel 
+  {
+    static const char* formula() {return "max(0.0001,1-y*([1]+(z-[0])*([2]+(z-[0])*[3]))/x)";}
+    static double evaluate(const double* fX, const float* fPar)
+    {
+      double x = fX[0], y = fX[1], z = fX[2];
+      double p0 = fPar[0], p1 = fPar[1], p2 = fPar[2], p3 = fPar[3];
+      return maxTMath(0.0001,1-y*(p1+(z-p0)*(p2+(z-p0)*p3))/x);
+    }
+  };
+  //---- L1Offset
+  struct L1OffsetKernel 
+  {
+    static const char* formula() {return "max(0.0001,1-([0]+[1]*(y-1)+[2]*pow(y-1,2))/x)";}
+    static double evaluate(const double* fX, const float* fPar)
+    {
+      double x = fX[0], y = fX[1];
+      double p0 = fPar[0], p1 = fPar[1], p2 = fPar[2];
+      return maxTMath(0.0001,1-(p0+p1*(y-1)+p2*((y-1)*(y-1)))/x);
+    }
+  };
+  //---- L2Relative (PF)
+  struct L2RelativeKernel 
+  {
+    static const char* formula() {return "([0]+([1]/((log10(x)^2)+[2])))+([3]*exp(-([4]*((log10(x)-[5])*(log10(x)-[5])))))";}
+    static double evaluate(const double* fX, const float* fPar)
+    {
+      double l = log10(fX[0]);
+      double p0 = fPar[0], p1 = fPar[1], p2 = fPar[2], p3 = fPar[3], p4 = fPar[4], p5 = fPar[5];
+      return (p0+(p1/((l*l)+p2)))+(p3*exp(-(p4*((l-p5)*(l-p5)))));
+    }
+  };
+  //---- L2Relative (Calo)
+  struct L2RelativeCaloKernel 
+  {
+    static const char* formula() {return "[0]+([1]/((log10(x)^[2])+[3]))";}
+    static double evaluate(const double* fX, const float* fPar)
+    {
+      double p0 = fPar[0], p1 = fPar[1], p2 = fPar[2], p3 = fPar[3];
+      return p0+(p1/((pow(log10(fX[0]),p2))+p3));
+    }
+  };
+  //---- L3Absolute
+  struct ConstantKernel 
+  {
+    static const char* formula() {return "1";}
+    static double evaluate(const double*, const float*) {return 1;}
+  };
+  //---- L2L3Residual, log-linear in pt
+  struct ResidualLogKernel 
+  {
+    static const char* formula() {return "[0]*([1]+[2]*TMath::Log(x))";}
+    static double evaluate(const double* fX, const float* fPar)
+    {
+      double p0 = fPar[0], p1 = fPar[1], p2 = fPar[2];
+      return p0*(p1+p2*log(fX[0]));
+    }
+  };
+  struct ResidualLogAltKernel : public ResidualLogKernel
+  {
+    static const char* formula() {return "[0]*([1]+[2]*log(x))";}
+  };
+  //---- L2L3Residual, constant
+  struct ResidualKernel 
+  {
+    static const char* formula() {return "[0]*[1]";}
+    static double evaluate(const double*, const float* fPar)
+    {
+      double p0 = fPar[0], p1 = fPar[1];
+      return p0*p1;
+    }
+  };
+  struct ParameterKernel 
+  {
+    static const char* formula() {return "[0]";}
+    static double evaluate(const double*, const float* fPar) {return fPar[0];}
+  };
+  //---- Data/MC scale factors, quadratic in pt
+  struct QuadraticKernel 
+  {
+    static const char* formula() {return "[0]+[1]*x+[2]*pow(x,2)";}
+    static double evaluate(const double* fX, const float* fPar)
+    {
+      double x = fX[0];
+      double p0 = fPar[0], p1 = fPar[1], p2 = fPar[2];
+      return p0+p1*x+p2*(x*x);
+    }
+  };
+  //------------------------------------------------------------------------
+  template<class K> double evaluateKernel(const double* fX, const float* fPar)
+  {
+    return K::evaluate(fX,fPar);
+  }
+  //---- the kernel is inlined in the loop: the parameters stay in 
+  //---- registers and the variables not used are never loaded
+  template<class K> void evaluateBatchKernel(unsigned fN, const double* const* fX, const float* fPar, double* fResult)
+  {
+    for(unsigned i=0;i<fN;i++)
+      {
+        double x[4] = {fX[0][i],fX[1][i],fX[2][i],fX[3][i]};
+        fResult[i] = K::evaluate(x,fPar);
+      }
+  }
+  struct KernelEntry
+  {
+    std::string                   mFormula;
+    FormulaEvaluator::Kernel      mKernel;
+    FormulaEvaluator::BatchKernel mBatchKernel;
+  };
+  template<class K> KernelEntry kernelEntry()
+  {
+    KernelEntry result = {K::formula(),&evaluateKernel<K>,&evaluateBatchKernel<K>};
+    return result;
+  }
+  //------------------------------------------------------------------------
+  //--- returns the kernel of a formula (blanks removed), 0 if none --------
+  //------------------------------------------------------------------------
+  const KernelEntry* findKernel(const std::string& fFormula)
+  {
+    static const KernelEntry kKernels[] = {
+      kernelEntry<L1FastJetKernel>(),   kernelEntry<L1FastJetRhoKernel>(),
+      kernelEntry<L1OffsetKernel>(),    kernelEntry<L2RelativeKernel>(),
+      kernelEntry<L2RelativeCaloKernel>(), kernelEntry<ConstantKernel>(),
+      kernelEntry<ResidualLogKernel>(), kernelEntry<ResidualLogAltKernel>(),
+      kernelEntry<ResidualKernel>(),    kernelEntry<ParameterKernel>(),
+      kernelEntry<QuadraticKernel>()
+    };
+    std::string formula;
+    for(unsigned i=0;i<fFormula.size();i++)
+      if (!isspace(fFormula[i]))
+        formula += fFormula[i];
+    for(unsigned i=0;i<sizeof(kKernels)/sizeof(kKernels[0]);i++)
+      if (formula == kKernels[i].mFormula)
+        return &kKernels[i];
+    return 0;
+  }
+}
+
+//------------------------------------------------------------------------
+//--- Default FormulaEvaluator constructor -------------------------------
+//--- evaluates to 0, like an empty TFormula -----------------------------
+//------------------------------------------------------------------------
+FormulaEvaluator::FormulaEvaluator() : mKernel(0),mBatchKernel(0),mNPar(0),mNVar(0),mDepth(0)
+{
+  emit(Instruction(kConst,0,0.));
+}
+//------------------------------------------------------------------------
+//--- FormulaEvaluator constructor ---------------------------------------
+//--- compiles the formula; an empty formula evaluates to 0 --------------
+//--- (uncertainty files write it as "") ---------------------------------
+//--- the program is always compiled, also to validate the formula and ---
+//--- count its parameters, even when a kernel will run it ---------------
+//------------------------------------------------------------------------
+FormulaEvaluator::FormulaEvaluator(const std::string& fFormula, bool fUseKernels) : mFormula(fFormula),mKernel(0),mBatchKernel(0),mNPar(0),mNVar(0),mDepth(0)
+{
+  const KernelEntry* entry = fUseKernels ? findKernel(fFormula) : 0;
+  if (entry != 0)
+    {
+      mKernel      = entry->mKernel;
+      mBatchKernel = entry->mBatchKernel;
+    }
+  const char* pos = mFormula.c_str();
+  while (isspace(*pos)) pos++;
+  if (*pos == '\0' || mFormula == "\"\"")
+    {
+      emit(Instruction(kConst,0,0.));
+      return;
+    }
+  parseSum(pos);
+  if (*pos != '\0')
+    error(pos,"unexpected character");
+}
+//------------------------------------------------------------------------
+//--- evaluates the postfix program --------------------------------------
+//------------------------------------------------------------------------
+double FormulaEvaluator::run(const double* fX, const float* fPar) const
+{
+  double stack[kMaxStack];
+  double* top = stack-1;
+  for(std::vector<Instruction>::const_iterator it=mCode.begin();it!=mCode.end();++it)
+    {
+      switch (it->mOp)
+        {
+          case kConst: *++top = it->mValue;                break;
+          case kVar:   *++top = fX[it->mIndex];            break;
+          case kPar:   *++top = fPar[it->mIndex];          break;
+          case kNeg:   *top = -*top;                       break;
+          case kAdd:   top--; *top = top[0] + top[1];      break;
+          case kSub:   top--; *top = top[0] - top[1];      break;
+          case kMul:   top--; *top = top[0] * top[1];      break;
+          case kDiv:   top--; *top = top[0] / top[1];      break;
+          case kPow:   top--; *top = pow(top[0],top[1]);   break;
+          case kSquare: *top = *top * *top;                break;
+          //---- as TMath::Max and TMath::Min
+          case kMax:   top--; *top = (top[0] > top[1]) ? top[0] : top[1]; break;
+          case kMin:   top--; *top = (top[0] < top[1]) ? top[0] : top[1]; break;
+          case kLog:   *top = log(*top);                   break;
+          case kLog10: *top = log10(*top);                 break;
+          case kExp:   *top = exp(*top);                   break;
+          case kSqrt:  *top = sqrt(*top);                  break;
+          case kAbs:   *top = fabs(*top);                  break;
+          case kSin:   *top = sin(*top);                   break;
+          case kCos:   *top = cos(*top);                   break;
+          case kTan:   *top = tan(*top);                   break;
+          case kAtan:  *top = atan(*top);                  break;
+          case kSinh:  *top = sinh(*top);                  break;
+          case kCosh:  *top = cosh(*top);                  break;
+          case kTanh:  *top = tanh(*top);                  break;
+        }
+    }
+  return *top;
+}
+//------------------------------------------------------------------------
+//--- evaluates the program on dual numbers (value, derivative) ----------
+//--- the values go through the same operations as in run(), so they -----
+//--- are bitwise equal to it; the derivatives follow the chain rule -----
+//------------------------------------------------------------------------
+double FormulaEvaluator::evaluate(const double* fX, const float* fPar, unsigned fVar, double& fDerivative) const
+{
+  double stack[kMaxStack],dstack[kMaxStack];
+  double* top  = stack-1;
+  double* dtop = dstack-1;
+  for(std::vector<Instruction>::const_iterator it=mCode.begin();it!=mCode.end();++it)
+    {
+      double a = 0, b = 0, da = 0, db = 0;
+      if (it->mOp == kConst || it->mOp == kVar || it->mOp == kPar)
+        {
+          top++;
+          dtop++;
+        }
+      else 
+        {
+          if (it->mOp >= kAdd && it->mOp <= kMin && it->mOp != kSquare)
+            {
+              //---- binary: a,b on the stack, the result replaces a
+              top--;
+              dtop--;
+              b  = top[1];
+              db = dtop[1];
+            }
+          a  = *top;
+          da = *dtop;
+        }
+      switch (it->mOp)
+        {
+          case kConst: *top = it->mValue;        *dtop = 0;                                   break;
+          case kVar:   *top = fX[it->mIndex];    *dtop = (it->mIndex == fVar) ? 1 : 0;        break;
+          case kPar:   *top = fPar[it->mIndex];  *dtop = 0;                                   break;
+          case kNeg:   *top = -a;                *dtop = -da;                                 break;
+          case kAdd:   *top = a + b;             *dtop = da + db;                             break;
+          case kSub:   *top = a - b;             *dtop = da - db;                             break;
+          case kMul:   *top = a * b;             *dtop = da*b + a*db;                         break;
+          case kDiv:   *top = a / b;             *dtop = (da - (a/b)*db)/b;                   break;
+          case kPow:   
+            *top  = pow(a,b);
+            //---- constant exponents, the usual case, also for a <= 0
+            *dtop = (db == 0) ? ((da == 0) ? 0 : b*pow(a,b-1)*da) : *top*(db*log(a) + b*da/a);
+            break;
+          case kSquare: *top = a * a;            *dtop = 2*a*da;                              break;
+          case kMax:   *top = (a > b) ? a : b;   *dtop = (a > b) ? da : db;                   break;
+          case kMin:   *top = (a < b) ? a : b;   *dtop = (a < b) ? da : db;                   break;
+          case kLog:   *top = log(a);            *dtop = da/a;                                break;
+          case kLog10: *top = log10(a);          *dtop = da/(a*M_LN10);                       break;
+          case kExp:   *top = exp(a);            *dtop = *top*da;                             break;
+          case kSqrt:  *top = sqrt(a);           *dtop = da/(2*(*top));                       break;
+          case kAbs:   *top = fabs(a);           *dtop = (a < 0) ? -da : da;                  break;
+          case kSin:   *top = sin(a);            *dtop = cos(a)*da;                           break;
+          case kCos:   *top = cos(a);            *dtop = -sin(a)*da;                          break;
+          case kTan:   *top = tan(a);            *dtop = (1 + (*top)*(*top))*da;              break;
+          case kAtan:  *top = atan(a);           *dtop = da/(1 + a*a);                        break;
+          case kSinh:  *top = sinh(a);           *dtop = cosh(a)*da;                          break;
+          case kCosh:  *top = cosh(a);           *dtop = sinh(a)*da;                          break;
+          case kTanh:  *top = tanh(a);           *dtop = (1 - (*top)*(*top))*da;              break;
+        }
+    }
+  fDerivative = *dtop;
+  return *top;
+}
+//------------------------------------------------------------------------
+//--- evaluates fN points, the variables in rows of fN values ------------
+//--- rows past nVariables() are never read, they alias the first --------
+//------------------------------------------------------------------------
+void FormulaEvaluator::evaluate(unsigned fN, const double* fX, const float* fPar, double* fResult) const
+{
+  const double* rows[4];
+  for(unsigned k=0;k<4;k++)
+    rows[k] = (k < mNVar) ? fX+k*fN : fX;
+  if (mBatchKernel != 0)
+    mBatchKernel(fN,rows,fPar,fResult);
+  else
+    for(unsigned i=0;i<fN;i++)
+      {
+        double x[4] = {rows[0][i],rows[1][i],rows[2][i],rows[3][i]};
+        fResult[i] = run(x,fPar);
+      }
+}
+//------------------------------------------------------------------------
+//--- sum := product (('+'|'-') product)* --------------------------------
+//------------------------------------------------------------------------
+void FormulaEvaluator::parseSum(const char*& fPos)
+{
+  parseProduct(fPos);
+  while (*fPos == '+' || *fPos == '-')
+    {
+      OpCode op = (*fPos == '+') ? kAdd : kSub;
+      fPos++;
+      parseProduct(fPos);
+      emit(Instruction(op));
+    }
+}
+//------------------------------------------------------------------------
+//--- product := unary (('*'|'/') unary)* --------------------------------
+//------------------------------------------------------------------------
+void FormulaEvaluator::parseProduct(const char*& fPos)
+{
+  parseUnary(fPos);
+  while (*fPos == '*' || *fPos == '/')
+    {
+      OpCode op = (*fPos == '*') ? kMul : kDiv;
+      fPos++;
+      parseUnary(fPos);
+      emit(Instruction(op));
+    }
+}
+//------------------------------------------------------------------------
+//--- unary := ('-'|'+') unary | power -----------------------------------
+//------------------------------------------------------------------------
+void FormulaEvaluator::parseUnary(const char*& fPos)
+{
+  while (isspace(*fPos)) fPos++;
+  if (*fPos == '-' || *fPos == '+')
+    {
+      bool negate = (*fPos == '-');
+      fPos++;
+      parseUnary(fPos);
+      if (negate)
+        emit(Instruction(kNeg));
+      return;
+    }
+  parsePower(fPos);
+}
+//------------------------------------------------------------------------
+//--- power := primary ('^' unary)? --------------------------------------
+//------------------------------------------------------------------------
+void FormulaEvaluator::parsePower(const char*& fPos)
+{
+  parsePrimary(fPos);
+  if (*fPos == '^')
+    {
+      fPos++;
+      parseUnary(fPos);
+      emit(Instruction(kPow));
+    }
+}
+//------------------------------------------------------------------------
+//--- primary := number | [i] | x y z t | function(...) | (sum) ----------
+//--- leaves fPos on the next non-blank character ------------------------
+//------------------------------------------------------------------------
+void FormulaEvaluator::parsePrimary(const char*& fPos)
+{
+  while (isspace(*fPos)) fPos++;
+  const char* begin = fPos;
+  if (isdigit(*fPos) || *fPos == '.')
+    {
+      char* end;
+      double value = strtod(fPos,&end);
+      if (end == fPos)
+        error(fPos,"bad number");
+      fPos = end;
+      emit(Instruction(kConst,0,value));
+    }
+  else if (*fPos == '[')
+    {
+      fPos++;
+      char* end;
+      unsigned long index = strtoul(fPos,&end,10);
+      if (end == fPos || !isdigit(*fPos))
+        error(fPos,"bad parameter index");
+      fPos = end;
+      expect(fPos,']');
+      emit(Instruction(kPar,index));
+      mNPar = std::max(mNPar,unsigned(index+1));
+    }
+  else if (*fPos == '(')
+    {
+      fPos++;
+      parseSum(fPos);
+      expect(fPos,')');
+    }
+  else if (isalpha(*fPos) || *fPos == '_')
+    {
+      while (isalnum(*fPos) || *fPos == '_' || (fPos[0] == ':' && fPos[1] == ':'))
+        fPos += (*fPos == ':') ? 2 : 1;
+      std::string name(begin,fPos);
+      const char* vars = "xyzt";
+      if (name.size() == 1 && strchr(vars,name[0]))
+        {
+          unsigned index = strchr(vars,name[0])-vars;
+          emit(Instruction(kVar,index));
+          mNVar = std::max(mNVar,index+1);
+        }
+      else
+        {
+          while (isspace(*fPos)) fPos++;
+          if (*fPos != '(')
+            error(begin,"unknown variable "+name);
+          fPos++;
+          parseFunction(name,fPos);
+        }
+    }
+  else
+    error(fPos,(*fPos == '\0') ? "unexpected end" : "unexpected character");
+  while (isspace(*fPos)) fPos++;
+}
+//------------------------------------------------------------------------
+//--- function arguments, after the opening bracket ----------------------
+//------------------------------------------------------------------------
+void FormulaEvaluator::parseFunction(const std::string& fName, const char*& fPos)
+{
+  static const struct {const char* name; OpCode op; unsigned nArg;} kFunctions[] = {
+    {"pow",kPow,2},  {"TMath::Power",kPow,2}, {"max",kMax,2},   {"TMath::Max",kMax,2},
+    {"min",kMin,2},  {"TMath::Min",kMin,2},   {"log",kLog,1},   {"TMath::Log",kLog,1},
+    {"log10",kLog10,1}, {"TMath::Log10",kLog10,1}, {"exp",kExp,1}, {"TMath::Exp",kExp,1},
+    {"sqrt",kSqrt,1},{"TMath::Sqrt",kSqrt,1}, {"abs",kAbs,1},   {"fabs",kAbs,1},
+    {"TMath::Abs",kAbs,1}, {"sin",kSin,1},    {"TMath::Sin",kSin,1}, {"cos",kCos,1},
+    {"TMath::Cos",kCos,1}, {"tan",kTan,1},    {"TMath::Tan",kTan,1}, {"atan",kAtan,1},
+    {"TMath::ATan",kAtan,1}, {"sinh",kSinh,1}, {"TMath::SinH",kSinh,1}, {"cosh",kCosh,1},
+    {"TMath::CosH",kCosh,1}, {"tanh",kTanh,1}, {"TMath::TanH",kTanh,1}
+  };
+  for(unsigned i=0;i<sizeof(kFunctions)/sizeof(kFunctions[0]);i++)
+    {
+      if (fName != kFunctions[i].name)
+        continue;
+      for(unsigned j=0;j<kFunctions[i].nArg;j++)
+        {
+          if (j > 0)
+            expect(fPos,',');
+          parseSum(fPos);
+        }
+      expect(fPos,')');
+      emit(Instruction(kFunctions[i].op));
+      return;
+    }
+  error(fPos-1,"unknown function "+fName);
+}
+//------------------------------------------------------------------------
+//--- skips the expected character and the blanks after it ---------------
+//------------------------------------------------------------------------
+void FormulaEvaluator::expect(const char*& fPos, char fChar)
+{
+  while (isspace(*fPos)) fPos++;
+  if (*fPos != fChar)
+    error(fPos,std::string("expected '")+fChar+"'");
+  fPos++;
+  while (isspace(*fPos)) fPos++;
+}
+//------------------------------------------------------------------------
+//--- appends an instruction and tracks the stack depth ------------------
+//------------------------------------------------------------------------
+void FormulaEvaluator::emit(const Instruction& fInstruction)
+{
+  //---- x^2 and pow(x,2) are evaluated as x*x, as compiled code does
+  if (fInstruction.mOp == kPow && mCode.back().mOp == kConst && mCode.back().mValue == 2.)
+    {
+      mCode.back() = Instruction(kSquare);
+      mDepth--;
+      return;
+    }
+  switch (fInstruction.mOp)
+    {
+      case kConst: case kVar: case kPar:
+        mDepth++;
+        break;
+      case kAdd: case kSub: case kMul: case kDiv: case kPow: case kMax: case kMin:
+        mDepth--;
+        break;
+      default:
+        break;
+    }
+  if (mDepth > kMaxStack)
+    error(mFormula.c_str()+mFormula.size(),"formula is nested too deeply");
+  mCode.push_back(fInstruction);
+}
+//------------------------------------------------------------------------
+//--- reports a parse error at fPos --------------------------------------
+//------------------------------------------------------------------------
+void FormulaEvaluator::error(const char* fPos, const std::string& fMessage) const
+{
+  std::stringstream sserr;
+  sserr<<fMessage<<" at position "<<(fPos-mFormula.c_str())<<" of formula "<<mFormula;
+  handleError("FormulaEvaluator",sserr.str());
+}
+//------------------------------------------------------------------------
+//--- FormulaEvaluatorRegistry accessor ----------------------------------
+//------------------------------------------------------------------------
+FormulaEvaluatorRegistry& FormulaEvaluatorRegistry::instance()
+{
+  static FormulaEvaluatorRegistry registry;
+  return registry;
+}
+//------------------------------------------------------------------------
+//--- removes the blanks that don't separate two names or numbers --------
+//--- (so that "a b" still fails to compile), and those at the ends ------
+//------------------------------------------------------------------------
+std::string FormulaEvaluatorRegistry::normalize(const std::string& fFormula)
+{
+  std::string result;
+  bool blank = false;
+  for(unsigned i=0;i<fFormula.size();i++)
+    {
+      char c = fFormula[i];
+      if (isspace(c))
+        {
+          blank = true;
+          continue;
+        }
+      bool word = isalnum(c) || c == '_' || c == '.';
+      if (blank && word && !result.empty())
+        {
+          char last = result[result.size()-1];
+          if (isalnum(last) || last == '_' || last == '.')
+            result += ' ';
+        }
+      result += c;
+      blank = false;
+    }
+  return result;
+}
+//------------------------------------------------------------------------
+//--- returns the compiled formula, compiling it on a miss ---------------
+//--- The lock is held while compiling so that concurrent requests for ---
+//--- the same formula never compile it twice. A formula that fails to ---
+//--- compile throws and is not cached. ----------------------------------
+//------------------------------------------------------------------------
+FormulaEvaluatorRegistry::Handle FormulaEvaluatorRegistry::get(const std::string& fFormula, bool fUseKernels)
+{
+  Key key(normalize(fFormula),fUseKernels);
+  std::lock_guard<std::mutex> lock(mMutex);
+  std::map<Key,Handle>::iterator it = mEntries.find(key);
+  if (it != mEntries.end())
+    {
+      mStats.mHits++;
+      return it->second;
+    }
+  Handle result(new FormulaEvaluator(fFormula,fUseKernels));
+  mEntries[key] = result;
+  mStats.mMisses++;
+  return result;
+}
+//------------------------------------------------------------------------
+//--- returns a snapshot of the cache statistics -------------------------
+//------------------------------------------------------------------------
+FormulaEvaluatorRegistry::Stats FormulaEvaluatorRegistry::stats() const
+{
+  std::lock_guard<std::mutex> lock(mMutex);
+  Stats result = mStats;
+  result.mEntries = mEntries.size();
+  return result;
+}
+//------------------------------------------------------------------------
+//--- prints the cache statistics ----------------------------------------
+//------------------------------------------------------------------------
+void FormulaEvaluatorRegistry::printStats(std::ostream& fOut) const
+{
+  Stats s = stats();
+  fOut<<"FormulaEvaluatorRegistry: "<<s.mMisses<<" formulas compiled, "
+      <<s.mHits<<" compilations avoided, "<<s.mEntries<<" entries"<<std::endl;
+}
+//------------------------------------------------------------------------
+//--- drops all cached formulas and resets the statistics ----------------
+//--- Handles already given out stay valid. ------------------------------
+//------------------------------------------------------------------------
+void FormulaEvaluatorRegistry::clear()
+{
+  std::lock_guard<std::mutex> lock(mMutex);
+  mEntries.clear();
+  mStats = Stats();
+}
+
+//--- End of the region without contraction ------------------------------
+#if defined(__clang__)
+#pragma STDC FP_CONTRACT DEFAULT
+#elif defined(__GNUC__)
+#pragma GCC pop_options
+#endif
@@ -28,6 +28,7 @@ JetCorrectionUncertainty::JetCorrectionUncertainty ()
   mIsLepPyset  = false;
   mIsLepPzset  = false;
   mAddLepToJet = false;
+  mCache       = 0;
   mUncertainty = new SimpleJetCorrectionUncertainty();
 }
 /////////////////////////////////////////////////////////////////////////
@@ -50,6 +51,7 @@ JetCorrectionUncertainty::JetCorrectionUncertainty(const JetCorrectorParameters&
   mIsLepPyset  = false;
   mIsLepPzset  = false;
   mAddLepToJet = false;
+  mCache       = 0;
   mUncertainty = new SimpleJetCorrectionUncertainty(fParameters);
 }
 /////////////////////////////////////////////////////////////////////////
@@ -72,12 +74,14 @@ JetCorrectionUncertainty::JetCorrectionUncertainty(const std::string& fDataFile)
   mIsLepPyset  = false;
   mIsLepPzset  = false;
   mAddLepToJet = false;
+  mCache       = 0;
   mUncertainty = new SimpleJetCorrectionUncertainty(fDataFile);
 }
 /////////////////////////////////////////////////////////////////////////
 JetCorrectionUncertainty::~JetCorrectionUncertainty () 
 {
   delete mUncertainty;
+  delete mCache;
 }
 /////////////////////////////////////////////////////////////////////////
 void JetCorrectionUncertainty::setParameters(const std::string& fDataFile) 
@@ -85,6 +89,27 @@ void JetCorrectionUncertainty::setParameters(const std::string& fDataFile)
   //---- delete the mParameters pointer before setting the new address ---
   delete mUncertainty; 
   mUncertainty = new SimpleJetCorrectionUncertainty(fDataFile);
+  if (mCache)
+    mCache->clear();
+}
+/////////////////////////////////////////////////////////////////////////
+void JetCorrectionUncertainty::setCache(unsigned fCapacity, CorrectionCache::Policy fPolicy, unsigned fBits)
+{
+  delete mCache;
+  mCache = 0;
+  if (fCapacity == 0)
+    return;
+  if (mUncertainty->parameters().definitions().nBinVar()+2 > CorrectionCache::kMaxKey)
+    {
+      cerr << "JetCorrectionUncertainty::"<<" too many variables for the cache";
+      return;
+    }
+  mCache = new CorrectionCache(fCapacity,fPolicy,fBits);
+}
+/////////////////////////////////////////////////////////////////////////
+CorrectionCache::Stats JetCorrectionUncertainty::cacheStats() const
+{
+  return mCache ? mCache->stats() : CorrectionCache::Stats();
 }
 /////////////////////////////////////////////////////////////////////////
 float JetCorrectionUncertainty::getUncertainty(bool fDirection) 
@@ -93,7 +118,26 @@ float JetCorrectionUncertainty::getUncertainty(bool fDirection)
   std::vector<float> vx,vy;
   vx = fillVector(mUncertainty->parameters().definitions().binVar());
   vy = fillVector(mUncertainty->parameters().definitions().parVar());
-  result = mUncertainty->uncertainty(vx,vy[0],fDirection);
+  if (!mCache)
+    result = mUncertainty->uncertainty(vx,vy[0],fDirection);
+  else
+    {
+      //---- key: the variables, rounded to the cache precision, and the direction
+      CorrectionCache::Key key;
+      for(unsigned i=0;i<vx.size();i++)
+        {
+          vx[i] = mCache->quantize(vx[i]);
+          key.push_back(vx[i]);
+        }
+      vy[0] = mCache->quantize(vy[0]);
+      key.push_back(vy[0]);
+      key.push_back(float(fDirection));
+      if (!mCache->find(key,result))
+        {
+          result = mUncertainty->uncertainty(vx,vy[0],fDirection);
+          mCache->insert(key,result);
+        }
+    }
   mIsJetEset   = false;
   mIsJetPtset  = false;
   mIsJetPhiset = false;
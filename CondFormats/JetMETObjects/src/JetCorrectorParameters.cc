@@ -14,12 +14,165 @@
 #include <algorithm>
 #include <cmath>
 #include <iterator>
+#include <map>
+#include <cstring>
+#include <stdint.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <zlib.h>
+
+namespace
+{
+  //------------------------------------------------------------------------ 
+  //--- Binary format ------------------------------------------------------
+  //--- header:  magic[8] version nSections --------------------------------
+  //--- section: name isResponse level formula nBinVar binVar[] nParVar ----
+  //---          parVar[] flags nRecords nParTotal xMin[] xMax[] ----------
+  //---          parOffset[nRecords+1] parameters[] ------------------------
+  //--- All fields are 4-byte words (strings are padded), so the arrays ----
+  //--- can be copied straight out of the mapped file. ---------------------
+  //------------------------------------------------------------------------
+  const char     kBinaryMagic[8]     = {'J','E','C','B','I','N','\0','\1'};
+  const unsigned kDefaultRecordFlag  = 1;
+  //------------------------------------------------------------------------ 
+  //--- Inflated bytes per gzread call (also the zlib input buffer size) ---
+  //------------------------------------------------------------------------ 
+  const unsigned kGzipBlock          = 256*1024;
+  //------------------------------------------------------------------------ 
+  void writeWord(std::ofstream& fOut, unsigned fValue)
+  {
+    uint32_t tmp = fValue;
+    fOut.write(reinterpret_cast<const char*>(&tmp),sizeof(tmp));
+  }
+  //------------------------------------------------------------------------ 
+  void writeString(std::ofstream& fOut, const std::string& fValue)
+  {
+    static const char pad[4] = {0,0,0,0};
+    writeWord(fOut,fValue.size());
+    fOut.write(fValue.data(),fValue.size());
+    fOut.write(pad,(4-fValue.size()%4)%4);
+  }
+  //------------------------------------------------------------------------ 
+  void writeFloats(std::ofstream& fOut, const std::vector<float>& fValues)
+  {
+    if (!fValues.empty())
+      fOut.write(reinterpret_cast<const char*>(&fValues[0]),fValues.size()*sizeof(float));
+  }
+  //------------------------------------------------------------------------ 
+  //--- Bounds-checked cursor over the mapped file -------------------------
+  //------------------------------------------------------------------------
+  class BinaryCursor
+  {
+    public:
+      BinaryCursor(const char* fBegin, size_t fSize, const std::string& fFile) : mPos(fBegin),mEnd(fBegin+fSize),mFile(fFile) {}
+      //-- fN items of fSize bytes; the count is checked before it is
+      //-- multiplied, so a corrupt count can't overflow
+      const char* skip(size_t fN, size_t fSize = 1)
+      {
+        if (fN > size_t(mEnd-mPos)/fSize)
+          {
+            std::stringstream sserr;
+            sserr<<"binary file "<<mFile<<" is truncated or corrupt";
+            handleError("JetCorrectorParameters",sserr.str());
+          }
+        const char* result = mPos;
+        mPos += fN*fSize;
+        return result;
+      }
+      unsigned word()
+      {
+        uint32_t tmp;
+        memcpy(&tmp,skip(sizeof(tmp)),sizeof(tmp));
+        return tmp;
+      }
+      std::string string()
+      {
+        //---- in size_t, so a corrupt length can't wrap around to a small one
+        unsigned n = word();
+        const char* p = skip(size_t(n)+(4-n%4)%4);
+        return std::string(p,n);
+      }
+      std::vector<std::string> strings()
+      {
+        unsigned n = word();
+        std::vector<std::string> result;
+        for(unsigned i=0;i<n;i++)
+          result.push_back(string());
+        return result;
+      }
+      const float* floats(size_t fN)        {return reinterpret_cast<const float*>(skip(fN,sizeof(float)));}
+      const uint32_t* words(size_t fN)      {return reinterpret_cast<const uint32_t*>(skip(fN,sizeof(uint32_t)));}
+    private:
+      const char* mPos;
+      const char* mEnd;
+      std::string mFile;
+  };
+  //------------------------------------------------------------------------ 
+  //--- orders record indices by the lower edge of bin variable 0, the ----
+  //--- way std::sort orders the records themselves ------------------------
+  //------------------------------------------------------------------------ 
+  class RecordOrder
+  {
+    public:
+      RecordOrder(const std::vector<float>& fXMin, unsigned fNvar) : mXMin(fXMin),mNvar(fNvar) {}
+      bool operator()(unsigned i, unsigned j) const {return mXMin[i*mNvar] < mXMin[j*mNvar];}
+    private:
+      const std::vector<float>& mXMin;
+      unsigned                  mNvar;
+  };
+  //------------------------------------------------------------------------ 
+  //--- parses a record line into its bin limits and parameters -----------
+  //--- the tokens point into the line, nothing is copied -----------------
+  //--- returns false for a line without tokens ----------------------------
+  //------------------------------------------------------------------------ 
+  bool parseRecord(const char* fBegin, const char* fEnd, unsigned fNvar, std::vector<TokenRange>& fTokens,
+                   float* fXMin, float* fXMax, std::vector<float>& fParameters)
+  {
+    getTokens(fBegin,fEnd,fTokens);
+    if (fTokens.empty())
+      return false;
+    if (fTokens.size() < 3) 
+      {
+        std::stringstream sserr;
+        sserr<<"(line "<<std::string(fBegin,fEnd)<<"): "<<"three tokens expected, "<<fTokens.size()<<" provided.";
+        handleError("JetCorrectorParameters::Record",sserr.str());
+      }
+    for(unsigned i=0;i<fNvar;i++)
+      {
+        fXMin[i] = getFloat(fTokens[i*fNvar].first,fTokens[i*fNvar].second);
+        fXMax[i] = getFloat(fTokens[i*fNvar+1].first,fTokens[i*fNvar+1].second); 
+      }
+    unsigned nParam = getUnsigned(fTokens[2*fNvar].first,fTokens[2*fNvar].second);
+    if (nParam != fTokens.size()-(2*fNvar+1)) 
+      {
+        std::stringstream sserr;
+        sserr<<"(line "<<std::string(fBegin,fEnd)<<"): "<<fTokens.size()-(2*fNvar+1)<<" parameters, but nParam="<<nParam<<".";
+        handleError("JetCorrectorParameters::Record",sserr.str());
+      }
+    for (unsigned i = (2*fNvar+1); i < fTokens.size(); ++i)
+      fParameters.push_back(getFloat(fTokens[i].first,fTokens[i].second));
+    return true;
+  }
+  //------------------------------------------------------------------------ 
+  //--- changes the number of bin variables of a flat limit table ---------
+  //------------------------------------------------------------------------ 
+  void restride(std::vector<float>& fX, unsigned fOld, unsigned fNew)
+  {
+    unsigned n = (fOld > 0 ? fX.size()/fOld : 0);
+    std::vector<float> result(size_t(n)*fNew,0);
+    for(unsigned i=0;i<n;i++)
+      std::copy(fX.begin()+i*fOld,fX.begin()+i*fOld+std::min(fOld,fNew),result.begin()+i*fNew);
+    fX.swap(result);
+  }
+}
 
 //------------------------------------------------------------------------ 
 //--- JetCorrectorParameters::Definitions constructor --------------------
 //--- takes specific arguments for the member variables ------------------
 //------------------------------------------------------------------------
-JetCorrectorParameters::Definitions::Definitions(const std::vector<std::string>& fBinVar, const std::vector<std::string>& fParVar, const std::string& fFormula, bool fIsResponse)
+JetCorrectorParameters::Definitions::Definitions(const std::vector<std::string>& fBinVar, const std::vector<std::string>& fParVar, const std::string& fFormula, bool fIsResponse, const std::string& fLevel)
 {
   for(unsigned i=0;i<fBinVar.size();i++)
     mBinVar.push_back(fBinVar[i]);
@@ -27,7 +180,7 @@ JetCorrectorParameters::Definitions::Definitions(const std::vector<std::string>&
     mParVar.push_back(fParVar[i]);
   mFormula    = fFormula;
   mIsResponse = fIsResponse;
-  mLevel      = "";
+  mLevel      = fLevel;
 }
 //------------------------------------------------------------------------
 //--- JetCorrectorParameters::Definitions constructor --------------------
@@ -73,36 +226,107 @@ JetCorrectorParameters::Definitions::Definitions(const std::string& fLine)
 }
 //------------------------------------------------------------------------
 //--- JetCorrectorParameters::Record constructor -------------------------
+//--- takes specific arguments for the member variables ------------------
+//------------------------------------------------------------------------
+JetCorrectorParameters::Record::Record(unsigned fNvar, const std::vector<float>& fXMin, const std::vector<float>& fXMax, const std::vector<float>& fParameters) : mNvar(fNvar),mNpar(fParameters.size())
+{
+  mStorage.assign(2*mNvar+mNpar,0);
+  std::copy(fXMin.begin(),fXMin.begin()+std::min<size_t>(mNvar,fXMin.size()),mStorage.begin());
+  std::copy(fXMax.begin(),fXMax.begin()+std::min<size_t>(mNvar,fXMax.size()),mStorage.begin()+mNvar);
+  std::copy(fParameters.begin(),fParameters.end(),mStorage.begin()+2*mNvar);
+  bind();
+}
+//------------------------------------------------------------------------
+//--- JetCorrectorParameters::Record constructor -------------------------
 //--- reads the member variables from a string ---------------------------
 //------------------------------------------------------------------------
-JetCorrectorParameters::Record::Record(const std::string& fLine,unsigned fNvar) : mMin(0),mMax(0)
+JetCorrectorParameters::Record::Record(const std::string& fLine,unsigned fNvar) : mNvar(fNvar),mNpar(0)
 {
-  mNvar = fNvar;
-  // quckly parse the line
-  std::vector<std::string> tokens = getTokens(fLine);
-  if (!tokens.empty())
-    { 
-      if (tokens.size() < 3) 
-        {
-          std::stringstream sserr;
-	  sserr<<"(line "<<fLine<<"): "<<"three tokens expected, "<<tokens.size()<<" provided.";
-          handleError("JetCorrectorParameters::Record",sserr.str());
-        }
-      for(unsigned i=0;i<mNvar;i++)
-        {
-          mMin.push_back(getFloat(tokens[i*mNvar]));
-          mMax.push_back(getFloat(tokens[i*mNvar+1])); 
-        }
-      unsigned nParam = getUnsigned(tokens[2*mNvar]);
-      if (nParam != tokens.size()-(2*mNvar+1)) 
+  std::vector<TokenRange> tokens;
+  std::vector<float> parameters;
+  mStorage.assign(2*mNvar,0);
+  parseRecord(fLine.c_str(),fLine.c_str()+fLine.size(),mNvar,tokens,mStorage.data(),mStorage.data()+mNvar,parameters);
+  mNpar = parameters.size();
+  mStorage.insert(mStorage.end(),parameters.begin(),parameters.end());
+  bind();
+}
+//------------------------------------------------------------------------
+//--- JetCorrectorParameters::Record copy constructor --------------------
+//--- views are copied as views, owned data is copied and re-bound -------
+//------------------------------------------------------------------------
+JetCorrectorParameters::Record::Record(const Record& fOther) : mNvar(fOther.mNvar),mNpar(fOther.mNpar),mMin(fOther.mMin),mMax(fOther.mMax),mPar(fOther.mPar),mStorage(fOther.mStorage)
+{
+  if (!mStorage.empty())
+    bind();
+}
+//------------------------------------------------------------------------
+JetCorrectorParameters::Record& JetCorrectorParameters::Record::operator= (const Record& fOther)
+{
+  if (this == &fOther)
+    return *this;
+  mNvar    = fOther.mNvar;
+  mNpar    = fOther.mNpar;
+  mMin     = fOther.mMin;
+  mMax     = fOther.mMax;
+  mPar     = fOther.mPar;
+  mStorage = fOther.mStorage;
+  if (!mStorage.empty())
+    bind();
+  return *this;
+}
+//------------------------------------------------------------------------
+//--- points the accessors at the owned storage --------------------------
+//------------------------------------------------------------------------
+void JetCorrectorParameters::Record::bind()
+{
+  mMin = mStorage.empty() ? 0 : &mStorage[0];
+  mMax = mMin+mNvar;
+  mPar = mMax+mNvar;
+}
+//------------------------------------------------------------------------
+//--- JetCorrectorParameters constructor ---------------------------------
+//--- takes the definitions and the records in the given order -----------
+//------------------------------------------------------------------------
+JetCorrectorParameters::JetCorrectorParameters(const JetCorrectorParameters::Definitions& fDefinitions,
+                                               const std::vector<JetCorrectorParameters::Record>& fRecords) 
+  : mDefinitions(fDefinitions)
+{
+  unsigned nVar = mDefinitions.nBinVar();
+  std::vector<float> xMin(fRecords.size()*nVar,0),xMax(fRecords.size()*nVar,0),parameters;
+  std::vector<unsigned> offset(1,0),order(fRecords.size());
+  for(unsigned i=0;i<fRecords.size();i++)
+    {
+      for(unsigned j=0;j<std::min(nVar,fRecords[i].nVar());j++)
         {
-          std::stringstream sserr;
-	  sserr<<"(line "<<fLine<<"): "<<tokens.size()-(2*mNvar+1)<<" parameters, but nParam="<<nParam<<".";
-          handleError("JetCorrectorParameters::Record",sserr.str());
+          xMin[i*nVar+j] = fRecords[i].xMin(j);
+          xMax[i*nVar+j] = fRecords[i].xMax(j);
         }
-      for (unsigned i = (2*mNvar+1); i < tokens.size(); ++i)
-        mParameters.push_back(getFloat(tokens[i]));
-    } 
+      Span par = fRecords[i].parameterSpan();
+      parameters.insert(parameters.end(),par.begin(),par.end());
+      offset.push_back(parameters.size());
+      order[i] = i;
+    }
+  pack(xMin,xMax,offset,parameters,order);
+  valid_ = true;
+  buildIndex();
+}
+//------------------------------------------------------------------------
+//--- JetCorrectorParameters constructor ---------------------------------
+//--- takes flat tables with the records in bin order --------------------
+//------------------------------------------------------------------------
+JetCorrectorParameters::JetCorrectorParameters(const JetCorrectorParameters::Definitions& fDefinitions, unsigned fNRecords,
+                                               const float* fXMin, const float* fXMax, const unsigned* fOffset, const float* fParameters)
+  : mDefinitions(fDefinitions)
+{
+  unsigned nVar = mDefinitions.nBinVar();
+  std::vector<float> xMin(fXMin,fXMin+fNRecords*nVar),xMax(fXMax,fXMax+fNRecords*nVar);
+  std::vector<unsigned> offset(fOffset,fOffset+fNRecords+1),order(fNRecords);
+  std::vector<float> parameters(fParameters,fParameters+offset[fNRecords]);
+  for(unsigned i=0;i<fNRecords;i++)
+    order[i] = i;
+  pack(xMin,xMax,offset,parameters,order);
+  valid_ = true;
+  buildIndex();
 }
 //------------------------------------------------------------------------
 //--- JetCorrectorParameters constructor ---------------------------------
@@ -110,54 +334,472 @@ JetCorrectorParameters::Record::Record(const std::string& fLine,unsigned fNvar)
 //------------------------------------------------------------------------
 JetCorrectorParameters::JetCorrectorParameters(const std::string& fFile, const std::string& fSection) 
 {
-  std::ifstream input(fFile.c_str());
-  std::string currentSection = "";
-  std::string line;
+  if (isBinaryFile(fFile))
+    {
+      std::vector<std::string> sections(1,fSection);
+      std::vector<JetCorrectorParameters> parameters;
+      readBinary(fFile,sections,parameters);
+      *this = parameters[0];
+      return;
+    }
+  std::string buffer;
+  SectionIndex index;
+  readFile(fFile,buffer);
+  indexSections(buffer,index,&fSection);
+  std::map<std::string,std::vector<LineSpan> >::const_iterator it = index.lines.find(fSection);
+  fill(buffer,(it != index.lines.end() ? it->second : std::vector<LineSpan>()),fSection,index.lastSection);
+}
+//------------------------------------------------------------------------
+//--- fills the definitions and records from the lines of a section ------
+//--- fLastSection is the last section header of the file ----------------
+//------------------------------------------------------------------------
+void JetCorrectorParameters::fill(const std::string& fBuffer, const std::vector<LineSpan>& fLines, 
+                                  const std::string& fSection, const std::string& fLastSection)
+{
   std::string currentDefinitions = "";
-  while (std::getline(input,line)) 
+  bool newDefinitions = false;
+  unsigned nVar = mDefinitions.nBinVar();
+  std::vector<TokenRange> tokens;
+  std::vector<float> xMin,xMax,parameters;
+  std::vector<unsigned> offset(1,0);
+  for(unsigned iline=0;iline<fLines.size();iline++)
     {
-      std::string section = getSection(line);
-      std::string tmp = getDefinitions(line);
-      if (!section.empty() && tmp.empty()) 
+      const char* begin = fBuffer.c_str()+fLines[iline].first;
+      const char* end   = begin+fLines[iline].second;
+      std::string tmp = getDefinitions(begin,end);
+      if (!tmp.empty()) 
         {
-          currentSection = section;
-          continue;
+          currentDefinitions = tmp;
+          newDefinitions = true;
+          continue; 
         }
-      if (currentSection == fSection) 
+      //---- the definitions are parsed at the first record that uses them
+      if (newDefinitions)
         {
-          if (!tmp.empty()) 
-            {
-              currentDefinitions = tmp;
-              continue; 
-            }
           Definitions definitions(currentDefinitions);
           if (!(definitions.nBinVar()==0 && definitions.formula()==""))
             mDefinitions = definitions;
-          Record record(line,mDefinitions.nBinVar());
-          bool check(true);
-          for(unsigned i=0;i<mDefinitions.nBinVar();++i)
-            if (record.xMin(i)==0 && record.xMax(i)==0)
-              check = false;
-          if (record.nParameters() == 0)
-            check = false;  
-          if (check)
-            mRecords.push_back(record);
-        } 
+          newDefinitions = false;
+          if (mDefinitions.nBinVar() != nVar)
+            {
+              restride(xMin,nVar,mDefinitions.nBinVar());
+              restride(xMax,nVar,mDefinitions.nBinVar());
+              nVar = mDefinitions.nBinVar();
+            }
+        }
+      //---- the record is parsed straight into the tables and dropped
+      //---- again if it has no parameters or an empty bin
+      size_t nMin = xMin.size();
+      size_t nPar = parameters.size();
+      xMin.resize(nMin+nVar);
+      xMax.resize(nMin+nVar);
+      bool check = parseRecord(begin,end,nVar,tokens,xMin.data()+nMin,xMax.data()+nMin,parameters);
+      check = check && parameters.size() != nPar;
+      for(unsigned i=0;i<nVar && check;++i)
+        if (xMin[nMin+i]==0 && xMax[nMin+i]==0)
+          check = false;
+      if (check)
+        offset.push_back(parameters.size());
+      else
+        {
+          xMin.resize(nMin);
+          xMax.resize(nMin);
+          parameters.resize(nPar);
+        }
     }
   if (currentDefinitions=="")
     handleError("JetCorrectorParameters","No definitions found!!!");
-  if (mRecords.empty() && currentSection == "") mRecords.push_back(Record());
-  if (mRecords.empty() && currentSection != "") 
+  if (offset.size() == 1 && fLastSection == "") 
+    {
+      //---- placeholder record without bins
+      xMin.assign(nVar,0);
+      xMax.assign(nVar,0);
+      offset.push_back(0);
+    }
+  if (offset.size() == 1 && fLastSection != "") 
     {
       std::stringstream sserr; 
       sserr<<"the requested section "<<fSection<<" doesn't exist!";
       handleError("JetCorrectorParameters",sserr.str()); 
     }
-  std::sort(mRecords.begin(), mRecords.end());
+  std::vector<unsigned> order(offset.size()-1);
+  for(unsigned i=0;i<order.size();i++)
+    order[i] = i;
+  if (nVar > 0)
+    std::sort(order.begin(),order.end(),RecordOrder(xMin,nVar));
+  pack(xMin,xMax,offset,parameters,order);
   valid_ = true;
+  buildIndex();
+}
+//------------------------------------------------------------------------
+//--- returns the names of the sections in a file ------------------------
+//------------------------------------------------------------------------
+void JetCorrectorParameters::getSections(const std::string& fFile, std::vector<std::string>& fSections)
+{
+  fSections.clear();
+  if (isBinaryFile(fFile))
+    {
+      std::vector<JetCorrectorParameters> parameters;
+      readBinary(fFile,fSections,parameters,false);
+      return;
+    }
+  std::string buffer;
+  SectionIndex index;
+  readFile(fFile,buffer);
+  indexSections(buffer,index);
+  fSections = index.names;
+}
+//------------------------------------------------------------------------
+//--- reads several sections with a single pass over the file ------------
+//--- an empty fSections reads all sections and returns their names ------
+//------------------------------------------------------------------------
+void JetCorrectorParameters::readSections(const std::string& fFile, std::vector<std::string>& fSections,
+                                          std::vector<JetCorrectorParameters>& fParameters)
+{
+  fParameters.clear();
+  if (isBinaryFile(fFile))
+    {
+      readBinary(fFile,fSections,fParameters);
+      return;
+    }
+  std::string buffer;
+  SectionIndex index;
+  readFile(fFile,buffer);
+  indexSections(buffer,index);
+  if (fSections.empty())
+    fSections = index.names;
+  fParameters.resize(fSections.size());
+  for(unsigned i=0;i<fSections.size();i++)
+    {
+      std::map<std::string,std::vector<LineSpan> >::const_iterator it = index.lines.find(fSections[i]);
+      fParameters[i].fill(buffer,(it != index.lines.end() ? it->second : std::vector<LineSpan>()),fSections[i],index.lastSection);
+    }
+}
+//------------------------------------------------------------------------
+//--- reads the whole file with one read ---------------------------------
+//--- gzip files are inflated block by block into the buffer ------------
+//------------------------------------------------------------------------
+void JetCorrectorParameters::readFile(const std::string& fFile, std::string& fBuffer)
+{
+  fBuffer.clear();
+  std::ifstream input(fFile.c_str(),std::ios::binary);
+  if (!input)
+    return;
+  unsigned char magic[2] = {0,0};
+  input.read(reinterpret_cast<char*>(magic),sizeof(magic));
+  if (input.gcount() == 2 && magic[0] == 0x1f && magic[1] == 0x8b)
+    {
+      input.close();
+      readGzipFile(fFile,fBuffer);
+      return;
+    }
+  input.clear();
+  input.seekg(0,std::ios::end);
+  std::streamoff length = input.tellg();
+  input.seekg(0,std::ios::beg);
+  if (length > 0)
+    {
+      fBuffer.resize(length);
+      input.read(&fBuffer[0],length);
+      fBuffer.resize(input.gcount());
+    }
+}
+//------------------------------------------------------------------------
+//--- inflates a gzip file into the buffer, one block at a time ---------
+//--- concatenated gzip members are read as one stream -------------------
+//------------------------------------------------------------------------
+void JetCorrectorParameters::readGzipFile(const std::string& fFile, std::string& fBuffer)
+{
+  gzFile input = gzopen(fFile.c_str(),"rb");
+  if (input == 0)
+    return;
+  gzbuffer(input,kGzipBlock);
+  size_t size = 0;
+  int n = 0;
+  do
+    {
+      fBuffer.resize(size+kGzipBlock);
+      n = gzread(input,&fBuffer[size],kGzipBlock);
+      if (n > 0) 
+        size += n;
+    }
+  while (n == int(kGzipBlock));
+  //---- a truncated file ends with Z_BUF_ERROR rather than n < 0
+  int errnum = Z_OK;
+  std::string message = gzerror(input,&errnum);
+  gzclose(input);
+  fBuffer.resize(size);
+  if (n < 0 || (errnum != Z_OK && errnum != Z_STREAM_END))
+    {
+      std::stringstream sserr;
+      sserr<<"gzip file "<<message; /// zlib's message starts with the file name
+      handleError("JetCorrectorParameters",sserr.str());
+    }
+}
+//------------------------------------------------------------------------
+//--- records the lines of every section ---------------------------------
+//--- section headers are "[name]" lines without definitions; lines -----
+//--- before the first header belong to the unnamed section "" ----------
+//--- if fSection is given only the lines of that section are recorded --
+//------------------------------------------------------------------------
+void JetCorrectorParameters::indexSections(const std::string& fBuffer, SectionIndex& fIndex, const std::string* fSection)
+{
+  fIndex.names.clear();
+  fIndex.lines.clear();
+  fIndex.lastSection = "";
+  std::vector<LineSpan>* current = (fSection == 0 || fSection->empty()) ? &fIndex.lines[""] : 0;
+  bool hasUnnamed = false;
+  bool hasHeader  = false;
+  const char* data = fBuffer.c_str();
+  size_t pos = 0;
+  while (pos < fBuffer.size())
+    {
+      const char* begin = data+pos;
+      const char* nl    = static_cast<const char*>(memchr(begin,'\n',fBuffer.size()-pos));
+      size_t end = (nl ? nl-data : fBuffer.size());
+      LineSpan span(pos,end-pos);
+      pos = end+1;
+      //---- only lines with brackets can be headers or definitions
+      if (strcspn(begin,"\n[{") < span.second)
+        {
+          std::string line(fBuffer,span.first,span.second);
+          std::string section = getSection(line);
+          std::string tmp = getDefinitions(line);
+          if (!section.empty() && tmp.empty()) 
+            {
+              if (fIndex.lines.find(section) == fIndex.lines.end())
+                fIndex.names.push_back(section);
+              std::vector<LineSpan>& lines = fIndex.lines[section];
+              current = (fSection == 0 || *fSection == section) ? &lines : 0;
+              fIndex.lastSection = section;
+              hasHeader = true;
+              continue;
+            }
+          if (!tmp.empty() && !hasHeader)
+            hasUnnamed = true;
+        }
+      if (current)
+        current->push_back(span);
+    }
+  if (hasUnnamed || !hasHeader)
+    fIndex.names.insert(fIndex.names.begin(),"");
+}
+//------------------------------------------------------------------------
+//--- checks for the binary magic at the start of the file ---------------
+//------------------------------------------------------------------------
+bool JetCorrectorParameters::isBinaryFile(const std::string& fFile)
+{
+  char magic[sizeof(kBinaryMagic)];
+  std::ifstream input(fFile.c_str(),std::ios::binary);
+  if (!input.read(magic,sizeof(magic)))
+    return false;
+  return memcmp(magic,kBinaryMagic,sizeof(magic)) == 0;
+}
+//------------------------------------------------------------------------
+//--- reads sections of a binary file through mmap -----------------------
+//--- an empty fSections reads all sections and returns their names ------
+//------------------------------------------------------------------------
+void JetCorrectorParameters::readBinary(const std::string& fFile, std::vector<std::string>& fSections,
+                                        std::vector<JetCorrectorParameters>& fParameters, bool fReadRecords)
+{
+  int fd = open(fFile.c_str(),O_RDONLY);
+  struct stat st;
+  if (fd < 0 || fstat(fd,&st) != 0)
+    {
+      if (fd >= 0) close(fd);
+      std::stringstream sserr; 
+      sserr<<"can't open binary file "<<fFile;
+      handleError("JetCorrectorParameters",sserr.str()); 
+    }
+  size_t length = st.st_size;
+  void* addr = mmap(0,length,PROT_READ,MAP_PRIVATE,fd,0);
+  close(fd);
+  if (addr == MAP_FAILED)
+    {
+      std::stringstream sserr; 
+      sserr<<"can't map binary file "<<fFile;
+      handleError("JetCorrectorParameters",sserr.str()); 
+    }
+  bool readAll = fSections.empty();
+  std::vector<bool> found(fSections.size(),false);
+  fParameters.resize(fSections.size());
+  try
+    {
+      BinaryCursor cursor(static_cast<const char*>(addr),length,fFile);
+      cursor.skip(sizeof(kBinaryMagic));
+      unsigned version = cursor.word();
+      if (version != kBinaryVersion)
+        {
+          std::stringstream sserr; 
+          sserr<<"binary file "<<fFile<<" has version "<<version<<", expected "<<kBinaryVersion;
+          handleError("JetCorrectorParameters",sserr.str()); 
+        }
+      unsigned nSections = cursor.word();
+      for(unsigned isec=0;isec<nSections;isec++)
+        {
+          std::string section          = cursor.string();
+          bool isResponse              = cursor.word();
+          std::string level            = cursor.string();
+          std::string formula          = cursor.string();
+          std::vector<std::string> bin = cursor.strings();
+          std::vector<std::string> par = cursor.strings();
+          unsigned flags               = cursor.word();
+          unsigned nRecords            = cursor.word();
+          unsigned nParTotal           = cursor.word();
+          unsigned nVar                = bin.size();
+          const float* xMin            = cursor.floats(size_t(nRecords)*nVar);
+          const float* xMax            = cursor.floats(size_t(nRecords)*nVar);
+          const uint32_t* offset       = cursor.words(size_t(nRecords)+1);
+          const float* parameters      = cursor.floats(nParTotal);
+          if (readAll)
+            {
+              fSections.push_back(section);
+              found.push_back(false);
+              fParameters.resize(fSections.size());
+            }
+          if (!fReadRecords)
+            continue;
+          for(unsigned k=0;k<fSections.size();k++)
+            {
+              if (fSections[k] != section || found[k])
+                continue;
+              found[k] = true;
+              JetCorrectorParameters& p = fParameters[k];
+              p.mDefinitions = Definitions(bin,par,formula,isResponse,level);
+              bool defaultRecord = (flags & kDefaultRecordFlag);
+              unsigned nBins = nRecords + (defaultRecord ? 1 : 0);
+              unsigned stride = 0;
+              for(unsigned i=0;i<nRecords;i++)
+                {
+                  if (offset[i] > offset[i+1] || offset[i+1] > nParTotal)
+                    {
+                      std::stringstream sserr;
+                      sserr<<"binary file "<<fFile<<" is truncated or corrupt";
+                      handleError("JetCorrectorParameters",sserr.str());
+                    }
+                  stride = std::max<unsigned>(stride,offset[i+1]-offset[i]);
+                }
+              p.mNvar   = nVar;
+              p.mStride = stride;
+              p.mXMin.assign(xMin,xMin+size_t(nRecords)*nVar);
+              p.mXMax.assign(xMax,xMax+size_t(nRecords)*nVar);
+              p.mXMin.resize(size_t(nBins)*nVar,0);
+              p.mXMax.resize(size_t(nBins)*nVar,0);
+              p.mNParameters.assign(nBins,0);
+              if (nRecords > 0 && offset[0] == 0 && offset[nRecords] == size_t(nRecords)*stride)
+                p.mParameters.assign(parameters,parameters+size_t(nRecords)*stride);
+              else
+                {
+                  p.mParameters.assign(size_t(nRecords)*stride,0);
+                  for(unsigned i=0;i<nRecords;i++)
+                    std::copy(parameters+offset[i],parameters+offset[i+1],p.mParameters.begin()+size_t(i)*stride);
+                }
+              p.mParameters.resize(size_t(nBins)*stride,0);
+              for(unsigned i=0;i<nRecords;i++)
+                p.mNParameters[i] = offset[i+1]-offset[i];
+              p.valid_ = true;
+              p.buildIndex();
+            }
+        }
+    }
+  catch(...)
+    {
+      munmap(addr,length);
+      throw;
+    }
+  munmap(addr,length);
+  if (!fReadRecords)
+    {
+      fParameters.clear();
+      return;
+    }
+  //---- a missing section has no definitions, as for the text files
+  for(unsigned k=0;k<fSections.size();k++)
+    if (!found[k])
+      handleError("JetCorrectorParameters","No definitions found!!!");
+}
+//------------------------------------------------------------------------
+//--- writes the sections in the binary format ---------------------------
+//------------------------------------------------------------------------
+void JetCorrectorParameters::printBinaryFile(const std::string& fFileName, 
+                                             const std::vector<std::string>& fSections,
+                                             const std::vector<JetCorrectorParameters>& fParameters)
+{
+  if (fSections.size() != fParameters.size())
+    {
+      std::stringstream sserr; 
+      sserr<<"number of sections "<<fSections.size()<<" doesn't match # of parameters: "<<fParameters.size();
+      handleError("JetCorrectorParameters",sserr.str()); 
+    }
+  std::ofstream output(fFileName.c_str(),std::ios::binary);
+  output.write(kBinaryMagic,sizeof(kBinaryMagic));
+  writeWord(output,kBinaryVersion);
+  writeWord(output,fSections.size());
+  for(unsigned isec=0;isec<fSections.size();isec++)
+    {
+      const JetCorrectorParameters& p = fParameters[isec];
+      const Definitions& def = p.definitions();
+      unsigned nVar = def.nBinVar();
+      //---- the placeholder record of an empty table has no bin variables
+      unsigned nRecords = p.size();
+      unsigned flags = 0;
+      if (nRecords == 1 && nVar > 0 && p.nParameters(0) == 0)
+        {
+          nRecords = 0;
+          flags |= kDefaultRecordFlag;
+        }
+      std::vector<float> xMin,xMax,parameters;
+      std::vector<unsigned> offset(1,0);
+      for(unsigned i=0;i<nRecords;i++)
+        {
+          for(unsigned j=0;j<nVar;j++)
+            {
+              xMin.push_back(p.xMin(i,j));
+              xMax.push_back(p.xMax(i,j));
+            }
+          Span par = p.parameters(i);
+          parameters.insert(parameters.end(),par.begin(),par.end());
+          offset.push_back(parameters.size());
+        }
+      writeString(output,fSections[isec]);
+      writeWord(output,def.isResponse());
+      writeString(output,def.level());
+      writeString(output,def.formula());
+      writeWord(output,nVar);
+      for(unsigned j=0;j<nVar;j++)
+        writeString(output,def.binVar(j));
+      writeWord(output,def.nParVar());
+      for(unsigned j=0;j<def.nParVar();j++)
+        writeString(output,def.parVar(j));
+      writeWord(output,flags);
+      writeWord(output,nRecords);
+      writeWord(output,parameters.size());
+      writeFloats(output,xMin);
+      writeFloats(output,xMax);
+      for(unsigned i=0;i<offset.size();i++)
+        writeWord(output,offset[i]);
+      writeFloats(output,parameters);
+    }
+  if (!output)
+    {
+      std::stringstream sserr; 
+      sserr<<"can't write binary file "<<fFileName;
+      handleError("JetCorrectorParameters",sserr.str()); 
+    }
+}
+//------------------------------------------------------------------------
+//--- converts a text file with all its sections to the binary format ----
+//------------------------------------------------------------------------
+void JetCorrectorParameters::convertToBinary(const std::string& fTextFile, const std::string& fBinaryFile)
+{
+  std::vector<std::string> sections;
+  std::vector<JetCorrectorParameters> parameters;
+  readSections(fTextFile,sections,parameters);
+  printBinaryFile(fBinaryFile,sections,parameters);
 }
 //------------------------------------------------------------------------
 //--- returns the index of the record defined by fX ----------------------
+//--- the first record (in the sorted order) containing fX is returned ---
 //------------------------------------------------------------------------
 int JetCorrectorParameters::binIndex(const std::vector<float>& fX) const 
 {
@@ -169,27 +811,209 @@ int JetCorrectorParameters::binIndex(const std::vector<float>& fX) const
       sserr<<"# bin variables "<<N<<" doesn't correspont to requested #: "<<fX.size();
       handleError("JetCorrectorParameters",sserr.str());
     }
-  unsigned tmp;
-  for (unsigned i = 0; i < size(); ++i) 
+  if (mIndexType == kGrid)
     {
-      tmp = 0;
+      unsigned cell = 0;
       for (unsigned j=0;j<N;j++)
-        if (fX[j] >= record(i).xMin(j) && fX[j] < record(i).xMax(j))
-          tmp+=1;
-      if (tmp==N)
-        { 
-          result = i;
-          break;
+        {
+          const std::vector<float>& edges = mEdges[j];
+          unsigned k = std::upper_bound(edges.begin(),edges.end(),fX[j]) - edges.begin();
+          if (k == 0 || k >= edges.size())
+            return -1;
+          cell = cell*(edges.size()-1) + k-1;
         }
-    } 
+      return mCells[cell];
+    }
+  if (mIndexType == kSegments)
+    {
+      unsigned k = std::upper_bound(mSegEdges.begin(),mSegEdges.end(),fX[0]) - mSegEdges.begin();
+      if (k == 0 || k >= mSegEdges.size())
+        return -1;
+      for (unsigned i = mSegBegin[k-1]; i < mSegBegin[k]; ++i)
+        if (contains(mSegRecords[i],fX))
+          return mSegRecords[i];
+      return -1;
+    }
+  for (unsigned i = 0; i < size(); ++i) 
+    if (contains(i,fX))
+      { 
+        result = i;
+        break;
+      }
   return result;
 }
 //------------------------------------------------------------------------
+//--- checks if fX is inside the bin fBin --------------------------------
+//------------------------------------------------------------------------
+bool JetCorrectorParameters::contains(unsigned fBin, const std::vector<float>& fX) const
+{
+  const float* xMin = mXMin.data()+fBin*mNvar;
+  const float* xMax = mXMax.data()+fBin*mNvar;
+  for (unsigned j=0;j<fX.size();j++)
+    if (!(fX[j] >= xMin[j] && fX[j] < xMax[j]))
+      return false;
+  return true;
+}
+//------------------------------------------------------------------------
+//--- returns a view of the record fBin ----------------------------------
+//------------------------------------------------------------------------
+JetCorrectorParameters::Record JetCorrectorParameters::record(unsigned fBin) const
+{
+  return Record(mNvar,mXMin.data()+fBin*mNvar,mXMax.data()+fBin*mNvar,mNParameters[fBin],parameterData(fBin));
+}
+//------------------------------------------------------------------------
+//--- packs the records in the order fOrder into the tables --------------
+//--- record i has the limits [i*nBinVar,(i+1)*nBinVar) of fXMin/fXMax ---
+//--- and the parameters [fOffset[i],fOffset[i+1]) of fParameters --------
+//------------------------------------------------------------------------
+void JetCorrectorParameters::pack(const std::vector<float>& fXMin, const std::vector<float>& fXMax, 
+                                  const std::vector<unsigned>& fOffset, const std::vector<float>& fParameters, 
+                                  const std::vector<unsigned>& fOrder)
+{
+  unsigned n = fOrder.size();
+  mNvar   = mDefinitions.nBinVar();
+  mStride = 0;
+  for(unsigned i=0;i<n;i++)
+    mStride = std::max(mStride,fOffset[i+1]-fOffset[i]);
+  mXMin.resize(n*mNvar);
+  mXMax.resize(n*mNvar);
+  mParameters.assign(n*mStride,0);
+  mNParameters.resize(n);
+  for(unsigned k=0;k<n;k++)
+    {
+      unsigned i = fOrder[k];
+      std::copy(fXMin.begin()+i*mNvar,fXMin.begin()+(i+1)*mNvar,mXMin.begin()+k*mNvar);
+      std::copy(fXMax.begin()+i*mNvar,fXMax.begin()+(i+1)*mNvar,mXMax.begin()+k*mNvar);
+      std::copy(fParameters.begin()+fOffset[i],fParameters.begin()+fOffset[i+1],mParameters.begin()+k*mStride);
+      mNParameters[k] = fOffset[i+1]-fOffset[i];
+    }
+}
+//------------------------------------------------------------------------
+//--- builds the bin lookup index ----------------------------------------
+//------------------------------------------------------------------------
+void JetCorrectorParameters::buildIndex()
+{
+  mIndexType = kLinearScan;
+  mEdges.clear();
+  mCells.clear();
+  mSegEdges.clear();
+  mSegBegin.clear();
+  mSegRecords.clear();
+  mNeighbours.clear();
+  mCenters.clear();
+  if (mDefinitions.nBinVar() == 0 || size() == 0)
+    return;
+  for (unsigned i = 0; i < size(); ++i) 
+    if (nParameters(i) == 0)
+      return; // placeholder record without bins
+  if (buildGridIndex())
+    mIndexType = kGrid;
+  else if (buildSegmentIndex())
+    mIndexType = kSegments;
+  buildNeighbours();
+}
+//------------------------------------------------------------------------
+//--- grid index: every usable record is exactly one cell of the grid ----
+//--- spanned by the distinct bin edges of each variable -----------------
+//------------------------------------------------------------------------
+bool JetCorrectorParameters::buildGridIndex()
+{
+  unsigned N = mDefinitions.nBinVar();
+  std::vector<std::vector<float> > edges(N);
+  std::vector<bool> usable(size(),true);
+  for (unsigned i = 0; i < size(); ++i) 
+    for (unsigned j=0;j<N;j++)
+      if (!(xMin(i,j) < xMax(i,j)))
+        usable[i] = false; // can never be matched
+  for (unsigned j=0;j<N;j++)
+    {
+      for (unsigned i = 0; i < size(); ++i) 
+        if (usable[i])
+          {
+            edges[j].push_back(xMin(i,j));
+            edges[j].push_back(xMax(i,j));
+          }
+      std::sort(edges[j].begin(),edges[j].end());
+      edges[j].erase(std::unique(edges[j].begin(),edges[j].end()),edges[j].end());
+      if (edges[j].size() < 2)
+        return false;
+    }
+  unsigned long nCells = 1;
+  for (unsigned j=0;j<N;j++)
+    {
+      nCells *= edges[j].size()-1;
+      if (nCells > 16*size()+1024)
+        return false;
+    }
+  std::vector<int> cells(nCells,-1);
+  for (unsigned i = 0; i < size(); ++i) 
+    {
+      if (!usable[i])
+        continue;
+      unsigned cell = 0;
+      for (unsigned j=0;j<N;j++)
+        {
+          std::vector<float>::const_iterator it = std::lower_bound(edges[j].begin(),edges[j].end(),xMin(i,j));
+          if (it+1 == edges[j].end() || *(it+1) != xMax(i,j))
+            return false; // spans more than one cell
+          cell = cell*(edges[j].size()-1) + (it-edges[j].begin());
+        }
+      if (cells[cell] < 0)
+        cells[cell] = i;
+    }
+  mEdges.swap(edges);
+  mCells.swap(cells);
+  return true;
+}
+//------------------------------------------------------------------------
+//--- segment index: the distinct edges of variable 0 cut the axis into --
+//--- segments, each listing the records overlapping it in index order --
+//------------------------------------------------------------------------
+bool JetCorrectorParameters::buildSegmentIndex()
+{
+  std::vector<float> edges;
+  for (unsigned i = 0; i < size(); ++i) 
+    if (xMin(i,0) < xMax(i,0))
+      {
+        edges.push_back(xMin(i,0));
+        edges.push_back(xMax(i,0));
+      }
+  std::sort(edges.begin(),edges.end());
+  edges.erase(std::unique(edges.begin(),edges.end()),edges.end());
+  if (edges.size() < 2)
+    return false;
+  unsigned nSeg = edges.size()-1;
+  std::vector<unsigned> first(size()),last(size());
+  std::vector<unsigned> begin(nSeg+1,0);
+  for (unsigned i = 0; i < size(); ++i) 
+    {
+      first[i] = last[i] = 0;
+      if (!(xMin(i,0) < xMax(i,0)))
+        continue;
+      first[i] = std::lower_bound(edges.begin(),edges.end(),xMin(i,0)) - edges.begin();
+      last[i]  = std::lower_bound(edges.begin(),edges.end(),xMax(i,0)) - edges.begin();
+      for (unsigned k = first[i]; k < last[i]; ++k)
+        begin[k+1]++;
+    }
+  for (unsigned k = 0; k < nSeg; ++k)
+    begin[k+1] += begin[k];
+  if (begin[nSeg] > 64*size()+4096)
+    return false; // heavily overlapping records, keep the linear scan
+  std::vector<unsigned> records(begin[nSeg]);
+  std::vector<unsigned> fill(begin.begin(),begin.end()-1);
+  for (unsigned i = 0; i < size(); ++i) 
+    for (unsigned k = first[i]; k < last[i]; ++k)
+      records[fill[k]++] = i;
+  mSegEdges.swap(edges);
+  mSegBegin.swap(begin);
+  mSegRecords.swap(records);
+  return true;
+}
+//------------------------------------------------------------------------
 //--- returns the neighbouring bins of fIndex in the direction of fVar ---
 //------------------------------------------------------------------------
 int JetCorrectorParameters::neighbourBin(unsigned fIndex, unsigned fVar, bool fNext) const 
 {
-  int result = -1;
   unsigned N = mDefinitions.nBinVar();
   if (fVar >= N) 
     {
@@ -197,34 +1021,56 @@ int JetCorrectorParameters::neighbourBin(unsigned fIndex, unsigned fVar, bool fN
       sserr<<"# of bin variables "<<N<<" doesn't correspond to requested #: "<<fVar;
       handleError("JetCorrectorParameters",sserr.str()); 
     }
-  unsigned tmp;
-  for (unsigned i = 0; i < size(); ++i) 
+  return mNeighbours[(fIndex*N+fVar)*2+(fNext ? 1 : 0)];
+}
+//------------------------------------------------------------------------
+//--- precomputes the neighbouring bins and the bin centers --------------
+//--- a neighbour shares xMin (within 0.0001) in all other variables -----
+//--- and touches the bin in fVar; the first such record is taken --------
+//------------------------------------------------------------------------
+void JetCorrectorParameters::buildNeighbours()
+{
+  unsigned N = mDefinitions.nBinVar();
+  mNeighbours.assign(size()*N*2,-1);
+  mCenters.assign(size()*N,0);
+  for (unsigned fVar=0;fVar<N;fVar++)
     {
-      tmp = 0;
-      for (unsigned j=0;j<fVar;j++)
-        if (fabs(record(i).xMin(j)-record(fIndex).xMin(j))<0.0001)
-          tmp+=1;
-      for (unsigned j=fVar+1;j<N;j++)
-        if (fabs(record(i).xMin(j)-record(fIndex).xMin(j))<0.0001)
-          tmp+=1;
-      if (tmp<N-1)
-        continue; 
-      if (tmp==N-1)
+      std::vector<std::pair<float,unsigned> > byMin,byMax;
+      for (unsigned i = 0; i < size(); ++i)
         {
-          if (fNext)
-            if (fabs(record(i).xMin(fVar)-record(fIndex).xMax(fVar))<0.0001)
-              tmp+=1;
-          if (!fNext)
-            if (fabs(record(i).xMax(fVar)-record(fIndex).xMin(fVar))<0.0001)
-              tmp+=1;
-        } 
-      if (tmp==N)
-        { 
-          result = i;
-          break;
+          mCenters[fVar*size()+i] = 0.5*(xMin(i,fVar)+xMax(i,fVar));
+          byMin.push_back(std::make_pair(xMin(i,fVar),i));
+          byMax.push_back(std::make_pair(xMax(i,fVar),i));
         }
-    } 
-  return result;
+      std::sort(byMin.begin(),byMin.end());
+      std::sort(byMax.begin(),byMax.end());
+      for (unsigned fIndex = 0; fIndex < size(); ++fIndex)
+        for (unsigned next = 0; next < 2; ++next)
+          {
+            //---- candidates touch the bin edge within the tolerance 
+            const std::vector<std::pair<float,unsigned> >& v = (next ? byMin : byMax);
+            float edge = (next ? xMax(fIndex,fVar) : xMin(fIndex,fVar));
+            std::vector<std::pair<float,unsigned> >::const_iterator it = 
+              std::lower_bound(v.begin(),v.end(),std::make_pair(float(edge-0.0002),0u));
+            int result = -1;
+            for (; it != v.end() && it->first <= edge+0.0002; ++it)
+              {
+                unsigned i = it->second;
+                if (result >= 0 && i >= unsigned(result))
+                  continue;
+                float x = (next ? xMin(i,fVar) : xMax(i,fVar));
+                if (!(fabs(x-edge)<0.0001))
+                  continue;
+                bool match = true;
+                for (unsigned j=0;j<N && match;j++)
+                  if (j != fVar && !(fabs(xMin(i,j)-xMin(fIndex,j))<0.0001))
+                    match = false;
+                if (match)
+                  result = i;
+              }
+            mNeighbours[(fIndex*N+fVar)*2+next] = result;
+          }
+    }
 }
 //------------------------------------------------------------------------
 //--- returns the number of bins in the direction of fVar ----------------
@@ -240,11 +1086,11 @@ unsigned JetCorrectorParameters::size(unsigned fVar) const
   unsigned result = 0;
   float tmpMin(-9999),tmpMax(-9999);
   for (unsigned i = 0; i < size(); ++i)
-    if (record(i).xMin(fVar) > tmpMin && record(i).xMax(fVar) > tmpMax)
+    if (xMin(i,fVar) > tmpMin && xMax(i,fVar) > tmpMax)
       { 
         result++;
-        tmpMin = record(i).xMin(fVar);
-        tmpMax = record(i).xMax(fVar);
+        tmpMin = xMin(i,fVar);
+        tmpMax = xMax(i,fVar);
       }
   return result; 
 }
@@ -253,10 +1099,7 @@ unsigned JetCorrectorParameters::size(unsigned fVar) const
 //------------------------------------------------------------------------
 std::vector<float> JetCorrectorParameters::binCenters(unsigned fVar) const 
 {
-  std::vector<float> result;
-  for (unsigned i = 0; i < size(); ++i)
-    result.push_back(record(i).xMiddle(fVar));
-  return result;
+  return std::vector<float>(mCenters.begin()+fVar*size(),mCenters.begin()+(fVar+1)*size());
 }
 //------------------------------------------------------------------------
 //--- prints parameters on screen ----------------------------------------
@@ -289,10 +1132,10 @@ void JetCorrectorParameters::printScreen() const
   for(unsigned i=0;i<size();i++)
     {
       for(unsigned j=0;j<definitions().nBinVar();j++)
-        std::cout<<record(i).xMin(j)<<" "<<record(i).xMax(j)<<" ";
-      std::cout<<record(i).nParameters()<<" ";
-      for(unsigned j=0;j<record(i).nParameters();j++)
-        std::cout<<record(i).parameter(j)<<" ";
+        std::cout<<xMin(i,j)<<" "<<xMax(i,j)<<" ";
+      std::cout<<nParameters(i)<<" ";
+      for(unsigned j=0;j<nParameters(i);j++)
+        std::cout<<parameters(i)[j]<<" ";
       std::cout<<std::endl;
     }  
 }
@@ -319,17 +1162,16 @@ void JetCorrectorParameters::printFile(const std::string& fFileName) const
   for(unsigned i=0;i<size();i++)
     {
       for(unsigned j=0;j<definitions().nBinVar();j++)
-        txtFile<<record(i).xMin(j)<<std::setw(15)<<record(i).xMax(j)<<std::setw(15);
-      txtFile<<record(i).nParameters()<<std::setw(15);
-      for(unsigned j=0;j<record(i).nParameters();j++)
-        txtFile<<record(i).parameter(j)<<std::setw(15);
+        txtFile<<xMin(i,j)<<std::setw(15)<<xMax(i,j)<<std::setw(15);
+      txtFile<<nParameters(i)<<std::setw(15);
+      for(unsigned j=0;j<nParameters(i);j++)
+        txtFile<<parameters(i)[j]<<std::setw(15);
       txtFile<<"\n";
     }
   txtFile.close();
 }
 
 
-/*
 const char * 
 JetCorrectorParametersCollection::labelsArray_[JetCorrectorParametersCollection::N_LEVELS] = 
   {
@@ -386,90 +1228,113 @@ std::vector<std::string>
 JetCorrectorParametersCollection::l7Partons_(l7PartonArray_, 
 					     l7PartonArray_ + sizeof(l7PartonArray_)/sizeof(*l7PartonArray_) );
 
+//------------------------------------------------------------------------
+//--- JetCorrectorParametersCollection constructor -----------------------
+//--- reads all sections of a file in one pass, labelled by their names --
+//------------------------------------------------------------------------
+JetCorrectorParametersCollection::JetCorrectorParametersCollection( std::string const & inputFile, key_type k )
+{
+  std::vector<std::string> sections;
+  std::vector<JetCorrectorParameters> parameters;
+  JetCorrectorParameters::readSections(inputFile,sections,parameters);
+  corrections_.reserve(parameters.size());
+  for(unsigned i=0;i<parameters.size();i++)
+    {
+      corrections_.push_back(pair_type(k,std::move(parameters[i])));
+      index(sections[i]);
+    }
+}
+//------------------------------------------------------------------------
+//--- returns the section names of a file, read in one pass --------------
+//------------------------------------------------------------------------
 void JetCorrectorParametersCollection::getSections( std::string inputFile,
 						    std::vector<std::string> & outputs )
 {
-  outputs.clear();
-  std::ifstream input( inputFile.c_str() );
-  while( !input.eof() ) {
-    char buff[10000];
-    input.getline(buff,10000);
-    std::string in(buff); 
-    if ( in[0] == '[' ) {
-      std::string tok = getSection(in);
-      if ( tok != "" ) {
-	outputs.push_back( tok );
-      }
-    }
-  }
-  std::cout << "Found these sections for file: " << std::endl;
-  copy(outputs.begin(),outputs.end(), std::ostream_iterator<std::string>(std::cout, "\n") );
+  JetCorrectorParameters::getSections(inputFile,outputs);
 } 
-
-
-// Add a JetCorrectorParameter object, possibly with flavor. 
+//------------------------------------------------------------------------
+//--- adds a JetCorrectorParameter object, possibly with flavor ----------
+//------------------------------------------------------------------------
 void JetCorrectorParametersCollection::push_back( key_type i, value_type const & j, label_type const & flav) { 
-  std::cout << "i    = " << i << std::endl;  
-  std::cout << "flav = " << flav << std::endl;
-  if ( isL5(i) ) {
-    std::cout << "This is L5, getL5Bin = " << getL5Bin(flav) << std::endl;
-    correctionsL5_.push_back( pair_type(getL5Bin(flav),j) ); 
-  }
-  else if ( isL7(i) ) {
-    std::cout << "This is L7, getL7Bin = " << getL7Bin(flav) << std::endl;
-    correctionsL7_.push_back( pair_type(getL7Bin(flav),j) );
-  }
-  else if ( flav == "" ) {
-    corrections_.push_back( pair_type(i,j) );
-  } else {
-    std::cout << "***** NOT ADDING " << flav << ", corresponding position in JetCorrectorParameters is not found." << std::endl;
-  }
+  key_type k = i;
+  if ( isL5(i) ) 
+    k = getL5Bin(flav);
+  else if ( isL7(i) ) 
+    k = getL7Bin(flav);
+  corrections_.push_back( pair_type(k,j) );
+  index( flav );
 }
-
-
-// Access the JetCorrectorParameter via the key k.
-// key_type is hashed to deal with the three collections
+//------------------------------------------------------------------------
+//--- hashes the last payload by its key and label -----------------------
+//--- the first payload added with a key is the one found by it ----------
+//--- a taken label drops the payload before its key is indexed ----------
+//------------------------------------------------------------------------
+void JetCorrectorParametersCollection::index( label_type const & label ) {
+  unsigned n = corrections_.size()-1;
+  if ( label != "" && !labelIndex_.insert( std::make_pair(label,n) ).second ) 
+    {
+      corrections_.pop_back();
+      handleError("JetCorrectorParametersCollection","label "+label+" is already in the collection");
+    }
+  keyIndex_.insert( std::make_pair(corrections_[n].first,n) );
+}
+//------------------------------------------------------------------------
+//--- access via the key k -----------------------------------------------
+//------------------------------------------------------------------------
 JetCorrectorParameters const & JetCorrectorParametersCollection::operator[]( key_type k ) const {
-  collection_type::const_iterator ibegin, iend, i;
-  if ( isL5(k) ) {
-    ibegin = correctionsL5_.begin();
-    iend = correctionsL5_.end();
-    i = ibegin;
-  } else if ( isL7(k) ) {
-    ibegin = correctionsL7_.begin();
-    iend = correctionsL7_.end();
-    i = ibegin;      
-  } else { 
-    ibegin = corrections_.begin();
-    iend = corrections_.end();
-    i = ibegin;
-  }
-  for ( ; i != iend; ++i ) {
-    if ( k == i->first ) return i->second;
-  }
-  //throw cms::Exception("InvalidInput") << " cannot find key " << static_cast<int>(k) << std::endl;
-  std::cerr << "InvalidInput: cannot find key " << static_cast<int>(k) << std::endl;
+  std::unordered_map<key_type,unsigned>::const_iterator it = keyIndex_.find(k);
+  if ( it == keyIndex_.end() )
+    {
+      std::stringstream sserr;
+      sserr<<"cannot find key "<<static_cast<int>(k);
+      handleError("JetCorrectorParametersCollection",sserr.str());
+    }
+  return corrections_[it->second].second;
 }
-
-// Get a list of valid keys. These will contain hashed keys
-// that are aware of all three collections. 
+//------------------------------------------------------------------------
+//--- access via a payload label or a level name -------------------------
+//------------------------------------------------------------------------
+JetCorrectorParameters const & JetCorrectorParametersCollection::operator[]( std::string const & label ) const {
+  std::unordered_map<label_type,unsigned>::const_iterator it = labelIndex_.find(label);
+  if ( it != labelIndex_.end() ) 
+    return corrections_[it->second].second;
+  return operator[]( findKey(label) );
+}
+//------------------------------------------------------------------------
+//--- is there a payload for this label or level name? -------------------
+//------------------------------------------------------------------------
+bool JetCorrectorParametersCollection::contains( std::string const & label ) const {
+  if ( labelIndex_.count(label) ) 
+    return true;
+  std::unordered_map<std::string,key_type>::const_iterator it = levelKeys().find(label);
+  return it != levelKeys().end() && keyIndex_.count(it->second);
+}
+//------------------------------------------------------------------------
+//--- list of valid keys, in insertion order -----------------------------
+//------------------------------------------------------------------------
 void JetCorrectorParametersCollection::validKeys(std::vector<key_type> & keys ) const {
   keys.clear();
-  for ( collection_type::const_iterator ibegin = corrections_.begin(),
-	  iend = corrections_.end(), i = ibegin; i != iend; ++i ) {
-    keys.push_back( i->first );
-  }
-  for ( collection_type::const_iterator ibegin = correctionsL5_.begin(),
-	  iend = correctionsL5_.end(), i = ibegin; i != iend; ++i ) {
-    keys.push_back( i->first );
-  }
-  for ( collection_type::const_iterator ibegin = correctionsL7_.begin(),
-	  iend = correctionsL7_.end(), i = ibegin; i != iend; ++i ) {
+  for ( collection_type::const_iterator i = corrections_.begin(); i != corrections_.end(); ++i ) {
     keys.push_back( i->first );
   }
 }
-
-
+//------------------------------------------------------------------------
+//--- level names and L5/L7 species -> key, built once -------------------
+//------------------------------------------------------------------------
+const std::unordered_map<std::string,JetCorrectorParametersCollection::key_type> & 
+JetCorrectorParametersCollection::levelKeys() {
+  static const std::unordered_map<std::string,key_type> keys = [] {
+    std::unordered_map<std::string,key_type> m;
+    for ( unsigned i = 0; i < labels_.size(); ++i ) 
+      m[labels_[i]] = i;
+    for ( unsigned i = 0; i < l5Flavors_.size(); ++i ) 
+      m[l5Flavors_[i]] = (i + 1) * 100;
+    for ( unsigned i = 0; i < l7Partons_.size(); ++i ) 
+      m[l7Partons_[i]] = (i + 1) * 1000;
+    return m;
+  }();
+  return keys;
+}
 // Find the L5 bin for hashing
 JetCorrectorParametersCollection::key_type
 JetCorrectorParametersCollection::getL5Bin( std::string const & flav ){
@@ -506,34 +1371,11 @@ bool JetCorrectorParametersCollection::isL7( key_type k ) {
 // Find the key corresponding to each label
 JetCorrectorParametersCollection::key_type 
 JetCorrectorParametersCollection::findKey( std::string const & label ) const {
-
-  // First check L5 corrections
-  std::vector<std::string>::const_iterator found1 =
-    find( l5Flavors_.begin(), l5Flavors_.end(), label );
-  if ( found1 != l5Flavors_.end() ) {
-    return getL5Bin(label);
-  } 
-
-  // Next check L7 corrections
-  std::vector<std::string>::const_iterator found2 =
-    find( l7Partons_.begin(), l7Partons_.end(), label );
-  if ( found2 != l7Partons_.end() ) {
-    return getL7Bin(label);
-  } 
-
-  // Finally check the default corrections
-  std::vector<std::string>::const_iterator found3 =
-    find( labels_.begin(), labels_.end(), label );
-  if ( found3 != labels_.end() ) {
-    return static_cast<key_type>(found3 - labels_.begin());
-  } 
-
-  // Didn't find default corrections, throw exception
-  //throw cms::Exception("InvalidInput") << " Cannot find label " << label << std::endl;
-  std::cerr << "InvalidInput: Cannot find label " << label << std::endl;
-
+  std::unordered_map<std::string,key_type>::const_iterator it = levelKeys().find(label);
+  if ( it == levelKeys().end() ) 
+    handleError("JetCorrectorParametersCollection","cannot find label "+label);
+  return it->second;
 }
-*/
 
 //#include "FWCore/Framework/interface/EventSetup.h"
 //#include "FWCore/Framework/interface/ESHandle.h"
@@ -543,5 +1385,5 @@ JetCorrectorParametersCollection::findKey( std::string const & label ) const {
 #include "FWCore/Utilities/interface/typelookup.h"
  
 TYPELOOKUP_DATA_REG(JetCorrectorParameters);
-//TYPELOOKUP_DATA_REG(JetCorrectorParametersCollection);
+TYPELOOKUP_DATA_REG(JetCorrectorParametersCollection);
 #endif
@@ -0,0 +1,90 @@
+//
+// Process-wide cache of parsed JetCorrectorParameters
+//
+#include "CondFormats/JetMETObjects/interface/JetCorrectorParametersRegistry.h"
+#include "CondFormats/JetMETObjects/src/Utilities.cc"
+#include <iostream>
+#include <iomanip>
+#include <sys/stat.h>
+
+//------------------------------------------------------------------------
+//--- JetCorrectorParametersRegistry accessor ----------------------------
+//--- A function-local static is initialised once, even across threads --
+//------------------------------------------------------------------------
+JetCorrectorParametersRegistry& JetCorrectorParametersRegistry::instance()
+{
+  static JetCorrectorParametersRegistry registry;
+  return registry;
+}
+//------------------------------------------------------------------------
+//--- returns the cached parameters, parsing the file on a miss ----------
+//--- The lock is held while parsing so that concurrent requests for the -
+//--- same file never parse it twice. ------------------------------------
+//------------------------------------------------------------------------
+JetCorrectorParametersRegistry::Handle JetCorrectorParametersRegistry::get(const std::string& fFile, const std::string& fSection)
+{
+  struct stat st;
+  if (stat(fFile.c_str(),&st) != 0)
+    {
+      std::stringstream sserr;
+      sserr<<"file "<<fFile<<" doesn't exist!";
+      handleError("JetCorrectorParametersRegistry",sserr.str());
+    }
+  Key key(fFile,fSection);
+  std::lock_guard<std::mutex> lock(mMutex);
+  std::map<Key,Entry>::iterator it = mEntries.find(key);
+  if (it != mEntries.end())
+    {
+      if (it->second.mMTime == st.st_mtime && it->second.mSize == st.st_size)
+        {
+          mStats.mHits++;
+          return it->second.mParameters;
+        }
+      mStats.mReloads++;
+    }
+  Entry entry;
+  entry.mMTime      = st.st_mtime;
+  entry.mSize       = st.st_size;
+  entry.mParameters = Handle(new JetCorrectorParameters(fFile,fSection));
+  mEntries[key] = entry;
+  mStats.mMisses++;
+  return entry.mParameters;
+}
+//------------------------------------------------------------------------
+//--- returns a snapshot of the cache statistics -------------------------
+//------------------------------------------------------------------------
+JetCorrectorParametersRegistry::Stats JetCorrectorParametersRegistry::stats() const
+{
+  std::lock_guard<std::mutex> lock(mMutex);
+  Stats result = mStats;
+  result.mEntries = mEntries.size();
+  return result;
+}
+//------------------------------------------------------------------------
+//--- prints the cache statistics ----------------------------------------
+//------------------------------------------------------------------------
+void JetCorrectorParametersRegistry::printStats(std::ostream& fOut) const
+{
+  Stats s = stats();
+  unsigned long requests = s.mHits + s.mMisses;
+  fOut<<"JetCorrectorParametersRegistry: "<<requests<<" requests, "
+      <<s.mHits<<" hits, "<<s.mMisses<<" misses ("<<s.mReloads<<" reloads), "
+      <<s.mEntries<<" entries";
+  if (requests > 0)
+    {
+      std::streamsize precision = fOut.precision();
+      fOut<<", hit rate "<<std::setprecision(3)<<100.*s.mHits/requests<<"%";
+      fOut.precision(precision);
+    }
+  fOut<<std::endl;
+}
+//------------------------------------------------------------------------
+//--- drops all cached entries and resets the statistics -----------------
+//--- Handles already given out stay valid. ------------------------------
+//------------------------------------------------------------------------
+void JetCorrectorParametersRegistry::clear()
+{
+  std::lock_guard<std::mutex> lock(mMutex);
+  mEntries.clear();
+  mStats = Stats();
+}
@@ -43,7 +43,7 @@ float SimpleJetCorrectionUncertainty::uncertaintyBin(unsigned fBin, float fY, bo
   if (fBin >= mParameters->size()) 
     //throw cms::Exception(
     cerr << "SimpleJetCorrectionUncertainty"<<" wrong bin: "<<fBin<<": only "<<mParameters->size()<<" are available";
-  const std::vector<float>& p = mParameters->record(fBin).parameters();
+  JetCorrectorParameters::Span p = mParameters->parameters(fBin);
   if ((p.size() % 3) != 0)
     //throw cms::Exception (
     cerr << "SimpleJetCorrectionUncertainty"<<"wrong # of parameters: multiple of 3 expected, "<<p.size()<< " got";
@@ -4,16 +4,32 @@
 #include <iostream>
 #include <sstream>
 #include <cmath>
+#include <algorithm>
+
+namespace
+{
+  //---- safeguarded inversion: relative tolerance on pt*R(pt) and the 
+  //---- most formula evaluations in one inversion
+  const double   kInvertPrecision = 1e-6;
+  const unsigned kMaxInvertEval   = 60;
+  //---- points of the per-bin inverse tables, log-spaced in JetPt
+  const unsigned kTableSize       = 64;
+}
 
 //------------------------------------------------------------------------ 
 //--- Default SimpleJetCorrector constructor -----------------------------
 //------------------------------------------------------------------------
 SimpleJetCorrector::SimpleJetCorrector() 
 { 
-  mFunc            = new TFormula(); 
+  mFunc            = FormulaEvaluatorRegistry::instance().get("");
   mParameters      = new JetCorrectorParameters();
   mDoInterpolation = false;
+  mIsResponse      = false;
+  mNParVar         = 0;
   mInvertVar       = 9999;
+  mPtVar           = 9999;
+  mInversionMode   = kFixedPoint;
+  resetInversionStats();
 }
 //------------------------------------------------------------------------ 
 //--- SimpleJetCorrector constructor -------------------------------------
@@ -22,10 +38,18 @@ SimpleJetCorrector::SimpleJetCorrector()
 SimpleJetCorrector::SimpleJetCorrector(const std::string& fDataFile, const std::string& fOption) 
 {
   mParameters      = new JetCorrectorParameters(fDataFile,fOption);
-  mFunc            = new TFormula("function",((mParameters->definitions()).formula()).c_str());
+  mFunc            = FormulaEvaluatorRegistry::instance().get((mParameters->definitions()).formula());
   mDoInterpolation = false;
-  if (mParameters->definitions().isResponse())
-    mInvertVar = findInvertVar(); 
+  mIsResponse      = mParameters->definitions().isResponse();
+  mNParVar         = mParameters->definitions().nParVar();
+  mInvertVar       = 9999;
+  mPtVar           = findVar("JetPt");
+  mInversionMode   = kFixedPoint;
+  resetInversionStats();
+  checkParameters();
+  if (mIsResponse)
+    mInvertVar = findInvertVar();
+  bindParameters();
 }
 //------------------------------------------------------------------------
 //--- SimpleJetCorrector constructor -------------------------------------
@@ -34,99 +58,285 @@ SimpleJetCorrector::SimpleJetCorrector(const std::string& fDataFile, const std::
 SimpleJetCorrector::SimpleJetCorrector(const JetCorrectorParameters& fParameters)
 {
   mParameters      = new JetCorrectorParameters(fParameters);
-  mFunc            = new TFormula("function",((mParameters->definitions()).formula()).c_str());
+  mFunc            = FormulaEvaluatorRegistry::instance().get((mParameters->definitions()).formula());
   mDoInterpolation = false;
-  if (mParameters->definitions().isResponse())
+  mIsResponse      = mParameters->definitions().isResponse();
+  mNParVar         = mParameters->definitions().nParVar();
+  mInvertVar       = 9999;
+  mPtVar           = findVar("JetPt");
+  mInversionMode   = kFixedPoint;
+  resetInversionStats();
+  checkParameters();
+  if (mIsResponse)
     mInvertVar = findInvertVar();
+  bindParameters();
 }
 //------------------------------------------------------------------------ 
 //--- SimpleJetCorrector destructor --------------------------------------
 //------------------------------------------------------------------------
 SimpleJetCorrector::~SimpleJetCorrector() 
 {
-  delete mFunc;
   delete mParameters;
 }
 //------------------------------------------------------------------------ 
 //--- calculates the correction ------------------------------------------
 //------------------------------------------------------------------------
 float SimpleJetCorrector::correction(const std::vector<float>& fX,const std::vector<float>& fY) const 
+{
+  return evaluateCorrection(fX,fY,0);
+}
+//------------------------------------------------------------------------ 
+//--- calculates the correction and its derivative with respect to pt ----
+//------------------------------------------------------------------------
+float SimpleJetCorrector::correctionAndDerivative(const std::vector<float>& fX,const std::vector<float>& fY,float& fDerivative) const 
+{
+  return evaluateCorrection(fX,fY,&fDerivative);
+}
+//------------------------------------------------------------------------ 
+//--- calculates the correction, and the derivative if fDerivative is ----
+//--- given: the interpolation is linear in the values of the three ------
+//--- bins, so the derivatives are interpolated the same way -------------
+//------------------------------------------------------------------------
+float SimpleJetCorrector::evaluateCorrection(const std::vector<float>& fX,const std::vector<float>& fY,float* fDerivative) const 
 {
   float result = 1.;
   float tmp    = 0.0;
   float cor    = 0.0;
+  float dtmp   = 0.0;
+  if (fDerivative)
+    *fDerivative = 0.0;
+  JEC_TIMER(timer);
+  JEC_COUNT(mStatCalls,1);
   int bin = mParameters->binIndex(fX);
+  JEC_LAP(timer,mSearchCycles);
   if (bin<0) 
-    return result;
+    {
+      JEC_COUNT(mStatNoBin,1);
+      return result;
+    }
   if (!mDoInterpolation)
-    result = correctionBin(bin,fY);
+    result = correctionBin(bin,fY,fDerivative);
   else
     { 
+      //---- the neighbours and bin centers are precomputed at load time
+      float dCenter = 0.0;
+      float center = correctionBin(bin,fY,fDerivative ? &dCenter : 0);
       for(unsigned i=0;i<mParameters->definitions().nBinVar();i++)
         { 
           float xMiddle[3];
           float xValue[3];
+          float dValue[3];
           int prevBin = mParameters->neighbourBin((unsigned)bin,i,false);
           int nextBin = mParameters->neighbourBin((unsigned)bin,i,true);
           if (prevBin>=0 && nextBin>=0)
             { 
-              xMiddle[0] = mParameters->record(prevBin).xMiddle(i);
-              xMiddle[1] = mParameters->record(bin).xMiddle(i);
-              xMiddle[2] = mParameters->record(nextBin).xMiddle(i);
-              xValue[0]  = correctionBin(prevBin,fY);
-              xValue[1]  = correctionBin(bin,fY);
-              xValue[2]  = correctionBin(nextBin,fY);
+              xMiddle[0] = mParameters->binCenter(prevBin,i);
+              xMiddle[1] = mParameters->binCenter(bin,i);
+              xMiddle[2] = mParameters->binCenter(nextBin,i);
+              xValue[0]  = correctionBin(prevBin,fY,fDerivative ? &dValue[0] : 0);
+              xValue[1]  = center;
+              xValue[2]  = correctionBin(nextBin,fY,fDerivative ? &dValue[2] : 0);
               cor = quadraticInterpolation(fX[i],xMiddle,xValue);
               tmp+=cor;
+              if (fDerivative)
+                {
+                  dValue[1] = dCenter;
+                  dtmp += quadraticInterpolation(fX[i],xMiddle,dValue);
+                }
             }
           else
             {
-              cor = correctionBin(bin,fY);
-              tmp+=cor;
+              tmp+=center;
+              dtmp+=dCenter;
             }
         }
       result = tmp/mParameters->definitions().nBinVar();        
+      if (fDerivative)
+        *fDerivative = dtmp/mParameters->definitions().nBinVar();
     }
+  JEC_LAP(timer,mIsResponse ? mInvertCycles : mEvalCycles);
   return result;
 }
 //------------------------------------------------------------------------ 
+//--- calculates the corrections of fN jets ------------------------------
+//--- the jets are sorted by bin (counting sort), then each bin clamps ---
+//--- its jets column by column and evaluates them in one loop with the --
+//--- bin's parameters. Interpolated and response corrections combine ----
+//--- several evaluations per jet and go through correction() instead. ---
+//------------------------------------------------------------------------
+void SimpleJetCorrector::correction(unsigned fN, const float* const* fX, const float* const* fY, float* fResult) const
+{
+  unsigned nBinVar = mParameters->definitions().nBinVar();
+  std::vector<float> x(nBinVar), y(mNParVar);
+  if (mDoInterpolation || mIsResponse)
+    {
+      for(unsigned i=0;i<fN;i++)
+        {
+          for(unsigned k=0;k<nBinVar;k++)  x[k] = fX[k][i];
+          for(unsigned k=0;k<mNParVar;k++) y[k] = fY[k][i];
+          fResult[i] = correction(x,y);
+        }
+      return;
+    }
+  //---- bin of every jet, and the jets grouped by bin
+  JEC_TIMER(timer);
+  JEC_COUNT(mStatCalls,fN);
+  std::vector<int> bins(fN);
+  std::vector<unsigned> first(mBins.size()+1,0), order(fN);
+  for(unsigned i=0;i<fN;i++)
+    {
+      for(unsigned k=0;k<nBinVar;k++) x[k] = fX[k][i];
+      bins[i] = mParameters->binIndex(x);
+      if (bins[i] < 0)
+        {
+          fResult[i] = 1.;
+          JEC_COUNT(mStatNoBin,1);
+        }
+      else
+        first[bins[i]+1]++;
+    }
+  for(unsigned bin=0;bin<mBins.size();bin++)
+    first[bin+1] += first[bin];
+  std::vector<unsigned> next(first.begin(),first.end()-1);
+  for(unsigned i=0;i<fN;i++)
+    if (bins[i] >= 0)
+      order[next[bins[i]]++] = i;
+  JEC_LAP(timer,mSearchCycles);
+  //---- per bin: clamp the columns, evaluate, scatter the results
+  std::vector<double> values(std::max(mNParVar,1u)*fN), results(fN);
+  for(unsigned bin=0;bin<mBins.size();bin++)
+    {
+      unsigned n = first[bin+1]-first[bin];
+      if (n == 0)
+        continue;
+      const Bin& b = mBins[bin];
+      const unsigned* jets = &order[first[bin]];
+      for(unsigned k=0;k<mNParVar;k++)
+        {
+          const float* column = fY[k];
+          double* row = &values[k*n];
+          for(unsigned j=0;j<n;j++)
+            {
+              float v = column[jets[j]];
+              row[j] = (v < b.mMin[k]) ? b.mMin[k] : (v > b.mMax[k]) ? b.mMax[k] : v;
+            }
+        }
+      mFunc->evaluate(n,&values[0],b.mPar,&results[0]);
+      for(unsigned j=0;j<n;j++)
+        fResult[jets[j]] = results[j];
+    }
+  JEC_LAP(timer,mEvalCycles);
+}
+//------------------------------------------------------------------------ 
 //--- calculates the correction for a specific bin -----------------------
 //------------------------------------------------------------------------
-float SimpleJetCorrector::correctionBin(unsigned fBin,const std::vector<float>& fY) const 
+float SimpleJetCorrector::correctionBin(unsigned fBin,const std::vector<float>& fY,float* fDerivative) const 
 {
-  if (fBin >= mParameters->size()) 
+  if (fBin >= mBins.size()) 
     {
       std::stringstream sserr;
-      sserr<<"wrong bin: "<<fBin<<": only "<<mParameters->size()<<" available!";
+      sserr<<"wrong bin: "<<fBin<<": only "<<mBins.size()<<" available!";
       handleError("SimpleJetCorrector",sserr.str());
     }
   unsigned N = fY.size();
-  if (N > 4)
+  if (N != mNParVar)
     {
       std::stringstream sserr;
-      sserr<<"two many variables: "<<N<<" maximum is 4";
+      sserr<<"wrong number of variables: "<<N<<", the formula needs "<<mNParVar;
       handleError("SimpleJetCorrector",sserr.str());
     } 
-  float result = -1;
-  const std::vector<float>& par = mParameters->record(fBin).parameters();
-  for(unsigned int i=2*N;i<par.size();i++)
-    mFunc->SetParameter(i-2*N,par[i]);
-  float x[4];
-  //std::vector<float> tmp;
-  std::vector<float> tmp(4); // MV
+  const Bin& b = mBins[fBin];
+  double x[4] = {0.0,0.0,0.0,0.0};
   for(unsigned i=0;i<N;i++)
+    x[i] = (fY[i] < b.mMin[i]) ? b.mMin[i] : (fY[i] > b.mMax[i]) ? b.mMax[i] : fY[i];
+  //---- no dependence on pt, or pt clamped to the range: flat
+  bool flat = (mPtVar >= N || x[mPtVar] != fY[mPtVar]);
+  if (fDerivative)
+    *fDerivative = 0.0;
+  if (!mIsResponse)
     {
-      x[i] = (fY[i] < par[2*i]) ? par[2*i] : (fY[i] > par[2*i+1]) ? par[2*i+1] : fY[i];
-      //tmp.push_back(x[i]);
-      tmp[i] = x[i]; // MV
+      if (!fDerivative || flat)
+        return mFunc->evaluate(x,b.mPar);
+      double derivative;
+      float result = mFunc->evaluate(x,b.mPar,mPtVar,derivative);
+      *fDerivative = derivative;
+      return result;
     }
-  if (mParameters->definitions().isResponse())
-    result = invert(tmp);
-  else
-    result = mFunc->Eval(x[0],x[1],x[2],x[3]);  
+  //---- the clamped values are floats, as the inversion expects
+  float y[4] = {float(x[0]),float(x[1]),float(x[2]),float(x[3])};
+  float result = (mInversionMode == kFixedPoint) ? invert(y,b.mPar) : invertSafeguarded(y,b.mPar,fBin);
+  if (fDerivative && !flat)
+    *fDerivative = responseDerivative(y,b.mPar,result);
   return result;
 }
 //------------------------------------------------------------------------ 
+//--- checks that every record has the parameters the formula uses -------
+//------------------------------------------------------------------------
+void SimpleJetCorrector::checkParameters() const
+{
+  unsigned nPar = mFunc->nParameters()+2*mParameters->definitions().nParVar();
+  for(unsigned i=0;i<mParameters->size();i++)
+    if (mParameters->nParameters(i) < nPar)
+      {
+        std::stringstream sserr;
+        sserr<<"formula "<<mFunc->formula()<<" needs "<<nPar<<" parameters, record "<<i<<" has "<<mParameters->nParameters(i);
+        handleError("SimpleJetCorrector",sserr.str());
+      }
+}
+//------------------------------------------------------------------------ 
+//--- binds the parameters of every record to its bin once, so that ------
+//--- correctionBin only reads them: no per-call setup of the formula ----
+//--- and no temporaries on the heap -------------------------------------
+//------------------------------------------------------------------------
+void SimpleJetCorrector::bindParameters()
+{
+  if (mNParVar > 4)
+    {
+      std::stringstream sserr;
+      sserr<<"two many variables: "<<mNParVar<<" maximum is 4";
+      handleError("SimpleJetCorrector",sserr.str());
+    }
+  mBins.resize(mParameters->size());
+  for(unsigned bin=0;bin<mBins.size();bin++)
+    {
+      JetCorrectorParameters::Span par = mParameters->parameters(bin);
+      Bin& b = mBins[bin];
+      for(unsigned i=0;i<4;i++)
+        {
+          b.mMin[i] = (i < mNParVar) ? par[2*i]   : 0.0;
+          b.mMax[i] = (i < mNParVar) ? par[2*i+1] : 0.0;
+        }
+      b.mPar = par.begin()+2*mNParVar;
+    }
+}
+//------------------------------------------------------------------------ 
+//--- index of a parameter variable, 9999 if the formula doesn't use it --
+//------------------------------------------------------------------------
+unsigned SimpleJetCorrector::findVar(const std::string& fName) const
+{
+  std::vector<std::string> vv = mParameters->definitions().parVar();
+  for(unsigned i=0;i<vv.size();i++)
+    if (vv[i]==fName)
+      return i;
+  return 9999;
+}
+//------------------------------------------------------------------------ 
+//--- derivative of an inverted response with respect to the raw pt ------
+//--- the corrected pt solves g(pt) = pt*R(pt) = ptraw, so dpt/dptraw ---
+//--- is 1/g'(pt) and the correction c = pt/ptraw has the derivative -----
+//--- (1/g' - c)/ptraw ---------------------------------------------------
+//------------------------------------------------------------------------
+float SimpleJetCorrector::responseDerivative(const float* fX, const float* fPar, float fCorrection) const
+{
+  double x[4] = {fX[0],fX[1],fX[2],fX[3]};
+  double raw = fX[mInvertVar];
+  double pt  = fCorrection*raw;
+  x[mInvertVar] = pt;
+  double slope;
+  double r = mFunc->evaluate(x,fPar,mInvertVar,slope);
+  return (1./(r + pt*slope) - fCorrection)/raw;
+}
+//------------------------------------------------------------------------ 
 //--- find invertion variable (JetPt) ------------------------------------
 //------------------------------------------------------------------------
 unsigned SimpleJetCorrector::findInvertVar()
@@ -146,10 +356,10 @@ unsigned SimpleJetCorrector::findInvertVar()
 //------------------------------------------------------------------------ 
 //--- inversion ----------------------------------------------------------
 //------------------------------------------------------------------------
-float SimpleJetCorrector::invert(std::vector<float> fX) const
+float SimpleJetCorrector::invert(const float* fX, const float* fPar) const
 {
   unsigned nMax = 50;
-  unsigned N = fX.size();
+  unsigned N = mNParVar;
   float precision = 0.0001;
   float rsp = 1.0;
   float e = 1.0;
@@ -159,14 +369,260 @@ float SimpleJetCorrector::invert(std::vector<float> fX) const
   unsigned nLoop=0;
   while(e > precision && nLoop < nMax) 
     {
-      rsp = mFunc->Eval(x[0],x[1],x[2],x[3]);
+      double xd[4] = {x[0],x[1],x[2],x[3]};
+      rsp = mFunc->evaluate(xd,fPar);
       float tmp = x[mInvertVar] * rsp;
       e = fabs(tmp - fX[mInvertVar])/fX[mInvertVar];
       x[mInvertVar] = fX[mInvertVar]/rsp;
       nLoop++;
     }
+  countInversion(nLoop);
   return 1./rsp;
 }
+//------------------------------------------------------------------------ 
+//--- safeguarded inversion ----------------------------------------------
+//--- solves pt*R(pt) = fX[mInvertVar] with the Illinois variant of ------
+//--- regula falsi: every step is a secant step inside a bracket of the --
+//--- root, so it cannot diverge, and halving the stale end keeps the ----
+//--- convergence superlinear. The bracket comes from the inverse table --
+//--- or from the fixed-point step, widened until it holds the root. -----
+//------------------------------------------------------------------------
+float SimpleJetCorrector::invertSafeguarded(const float* fX, const float* fPar, unsigned fBin) const
+{
+  unsigned N = mNParVar;
+  double x[4] = {0.0,0.0,0.0,0.0};
+  for(unsigned i=0;i<N;i++)
+    x[i] = fX[i];
+  double target = fX[mInvertVar];
+  double tolerance = kInvertPrecision*target;
+  unsigned nEval = 0;
+  double a,b,fa,fb;
+  if (mInversionMode == kTabulated && tableBracket(fBin,target,a,b,fa,fb))
+    {
+      //---- the table values are the residuals, no evaluation needed
+    }
+  else
+    {
+      a  = target;
+      fa = residual(x,a,fPar,nEval);
+      if (fabs(fa) <= tolerance)
+        {
+          countInversion(nEval);
+          return a/(fa+target);
+        }
+      b  = target*a/(fa+target); /// fixed-point step pt/R(pt)
+      fb = residual(x,b,fPar,nEval);
+      double step = b-a;
+      while (fa*fb > 0 && nEval < kMaxInvertEval)
+        {
+          a    = b;
+          fa   = fb;
+          step = 2*step;
+          b    = std::max(a+step,0.5*a);
+          fb   = residual(x,b,fPar,nEval);
+        }
+    }
+  if (fa*fb > 0)
+    {
+      //---- the fixed point counts the call, add what was spent here
+      mFailures.fetch_add(1,std::memory_order_relaxed);
+      mEvaluations.fetch_add(nEval,std::memory_order_relaxed);
+      return invert(fX,fPar);
+    }
+  //---- t is the best point so far, dt the slope there once known
+  double t  = (fabs(fa) < fabs(fb)) ? a : b;
+  double ft = (fabs(fa) < fabs(fb)) ? fa : fb;
+  double dt = 0;
+  int side = 0;
+  while (fabs(ft) > tolerance && nEval < kMaxInvertEval)
+    {
+      //---- Newton step if it stays inside the bracket, else secant
+      double newton = (dt != 0) ? t - ft/dt : a;
+      if ((newton-a)*(newton-b) < 0)
+        {
+          t    = newton;
+          side = 0;
+        }
+      else
+        t  = (a*fb - b*fa)/(fb - fa);
+      ft = residual(x,t,fPar,nEval,&dt);
+      if (ft*fb > 0)
+        {
+          b  = t;
+          fb = ft;
+          if (side == -1) fa *= 0.5;
+          side = -1;
+        }
+      else if (fa*ft > 0)
+        {
+          a  = t;
+          fa = ft;
+          if (side == +1) fb *= 0.5;
+          side = +1;
+        }
+      else
+        break;
+    }
+  countInversion(nEval);
+  return t/(ft+target);
+}
+//------------------------------------------------------------------------ 
+//--- pt*R(pt) - target, with the target in fX[mInvertVar] ---------------
+//--- and its slope in fSlope if given -----------------------------------
+//------------------------------------------------------------------------
+double SimpleJetCorrector::residual(double* fX, double fPt, const float* fPar, unsigned& fNEval, double* fSlope) const
+{
+  double target = fX[mInvertVar];
+  fX[mInvertVar] = fPt;
+  double result;
+  if (fSlope)
+    {
+      //---- d(pt*R)/dpt = R + pt*dR/dpt
+      double derivative;
+      double r = mFunc->evaluate(fX,fPar,mInvertVar,derivative);
+      result  = fPt*r - target;
+      *fSlope = r + fPt*derivative;
+    }
+  else
+    result = fPt*mFunc->evaluate(fX,fPar) - target;
+  fX[mInvertVar] = target;
+  fNEval++;
+  return result;
+}
+//------------------------------------------------------------------------ 
+//--- looks up the table points that bracket the target ------------------
+//------------------------------------------------------------------------
+bool SimpleJetCorrector::tableBracket(unsigned fBin, double fTarget, double& fLow, double& fHigh,
+                                      double& fResLow, double& fResHigh) const
+{
+  if (fBin >= mInverseValid.size() || !mInverseValid[fBin])
+    return false;
+  const double* table = &mInverseTable[2*fBin*kTableSize];
+  unsigned low = 0, high = kTableSize-1;
+  if (fTarget < table[2*low+1] || fTarget > table[2*high+1])
+    return false;
+  while (high-low > 1)
+    {
+      unsigned mid = (low+high)/2;
+      if (table[2*mid+1] < fTarget)
+        low = mid;
+      else
+        high = mid;
+    }
+  fLow     = table[2*low];
+  fHigh    = table[2*high];
+  fResLow  = table[2*low+1]-fTarget;
+  fResHigh = table[2*high+1]-fTarget;
+  return true;
+}
+//------------------------------------------------------------------------ 
+//--- tabulates pt*R(pt) over the JetPt range of every bin ---------------
+//--- a bin is usable only if the table rises strictly; tables need a ----
+//--- formula of JetPt alone, as the other variables are not known here --
+//------------------------------------------------------------------------
+void SimpleJetCorrector::buildInverseTable()
+{
+  unsigned N = mNParVar;
+  unsigned nBins = mBins.size();
+  mInverseTable.assign(2*nBins*kTableSize,0.);
+  mInverseValid.assign(nBins,false);
+  if (N != 1)
+    return;
+  for(unsigned bin=0;bin<nBins;bin++)
+    {
+      double lo = mBins[bin].mMin[0], hi = mBins[bin].mMax[0];
+      if (!(lo > 0 && hi > lo))
+        continue;
+      double* table = &mInverseTable[2*bin*kTableSize];
+      bool valid = true;
+      for(unsigned i=0;i<kTableSize;i++)
+        {
+          double x[4] = {0.0,0.0,0.0,0.0};
+          x[0] = lo*pow(hi/lo,double(i)/(kTableSize-1));
+          table[2*i]   = x[0];
+          table[2*i+1] = x[0]*mFunc->evaluate(x,mBins[bin].mPar);
+          if (i > 0 && !(table[2*i+1] > table[2*i-1]))
+            valid = false;
+        }
+      mInverseValid[bin] = valid;
+    }
+}
+//------------------------------------------------------------------------ 
+//--- selects the inversion method ---------------------------------------
+//------------------------------------------------------------------------
+void SimpleJetCorrector::setInversion(InversionMode fMode)
+{
+  mInversionMode = fMode;
+  if (fMode == kTabulated && mIsResponse)
+    buildInverseTable();
+  else
+    {
+      mInverseTable.clear();
+      mInverseValid.clear();
+    }
+}
+//------------------------------------------------------------------------ 
+//--- accumulates the inversion diagnostics ------------------------------
+//--- the counters are atomic so that concurrent corrections may count ---
+//------------------------------------------------------------------------
+void SimpleJetCorrector::countInversion(unsigned fNEval) const
+{
+  mCalls.fetch_add(1,std::memory_order_relaxed);
+  mEvaluations.fetch_add(fNEval,std::memory_order_relaxed);
+  unsigned long max = mMaxEvaluations.load(std::memory_order_relaxed);
+  while (fNEval > max && !mMaxEvaluations.compare_exchange_weak(max,fNEval,std::memory_order_relaxed))
+    {}
+}
+//------------------------------------------------------------------------ 
+//--- snapshot of the inversion diagnostics ------------------------------
+//------------------------------------------------------------------------
+SimpleJetCorrector::InversionStats SimpleJetCorrector::inversionStats() const
+{
+  InversionStats result;
+  result.mCalls          = mCalls.load(std::memory_order_relaxed);
+  result.mEvaluations    = mEvaluations.load(std::memory_order_relaxed);
+  result.mMaxEvaluations = mMaxEvaluations.load(std::memory_order_relaxed);
+  result.mFailures       = mFailures.load(std::memory_order_relaxed);
+  return result;
+}
+//------------------------------------------------------------------------ 
+//--- resets the inversion diagnostics -----------------------------------
+//------------------------------------------------------------------------
+void SimpleJetCorrector::resetInversionStats()
+{
+  mCalls          = 0;
+  mEvaluations    = 0;
+  mMaxEvaluations = 0;
+  mFailures       = 0;
+}
+//------------------------------------------------------------------------ 
+//--- Calls and cycles, see JEC_INSTRUMENT -------------------------------
+//------------------------------------------------------------------------
+SimpleJetCorrector::CallStats SimpleJetCorrector::callStats() const
+{
+  CallStats result;
+  result.mInversions   = mCalls.load(std::memory_order_relaxed);
+  result.mEvaluations  = mEvaluations.load(std::memory_order_relaxed);
+#ifdef JEC_INSTRUMENT
+  result.mCalls        = mStatCalls.value();
+  result.mNoBin        = mStatNoBin.value();
+  result.mSearchCycles = mSearchCycles.value();
+  result.mEvalCycles   = mEvalCycles.value();
+  result.mInvertCycles = mInvertCycles.value();
+#endif
+  return result;
+}
+void SimpleJetCorrector::resetCallStats()
+{
+  resetInversionStats();
+#ifdef JEC_INSTRUMENT
+  mStatCalls.reset();
+  mStatNoBin.reset();
+  mSearchCycles.reset();
+  mEvalCycles.reset();
+  mInvertCycles.reset();
+#endif
+}
 
 
 
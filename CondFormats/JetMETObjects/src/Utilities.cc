@@ -6,6 +6,9 @@
 #include <string>
 #include <vector>
 #include <cmath>
+#include <cfloat>
+#include <algorithm>
+#include <utility>
 
 #define STANDALONE
 
@@ -19,10 +22,92 @@ namespace
 {
   void handleError(const std::string& fClass, const std::string& fMessage);
   //----------------------------------------------------------------------
-  float getFloat(const std::string& token) 
+  //--- A token is a [begin,end) range inside a line. The line must lie
+  //--- in a NUL-terminated buffer (a std::string or the whole file), 
+  //--- so the number parsers can run on it without copying the token.
+  typedef std::pair<const char*,const char*> TokenRange;
+  //----------------------------------------------------------------------
+  //--- Fast path for plain decimal tokens [+-]ddd[.ddd][e[+-]ddd] with at 
+  //--- most 15 significant digits and |exponent| <= 22: both the digits
+  //--- and the power of ten are exact doubles, so one multiplication or 
+  //--- division gives the correctly rounded value, the same as strtod. 
+  //--- Anything else returns false and is left to strtod.
+  bool getDecimal(const char* fBegin, const char* fEnd, double& fResult)
+  {
+#if FLT_EVAL_METHOD == 0
+    static const double kPow10[23] = {1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+                                      1e12,1e13,1e14,1e15,1e16,1e17,1e18,1e19,1e20,1e21,1e22};
+    const char* pos = fBegin;
+    bool negative = false;
+    if (pos != fEnd && (*pos == '-' || *pos == '+'))
+      negative = (*pos++ == '-');
+    unsigned long long mantissa = 0;
+    int digits = 0, exponent = 0;
+    bool any = false, fraction = false;
+    for (; pos != fEnd; ++pos)
+      {
+        char c = *pos;
+        if (c == '.' && !fraction)
+          {
+            fraction = true;
+            continue;
+          }
+        if (c < '0' || c > '9')
+          break;
+        any = true;
+        if (fraction) 
+          --exponent;
+        if (mantissa == 0 && c == '0')
+          continue; // leading zeros are not significant
+        if (++digits > 15)
+          return false;
+        mantissa = mantissa*10 + (c-'0');
+      }
+    if (!any)
+      return false;
+    if (pos != fEnd && (*pos == 'e' || *pos == 'E'))
+      {
+        ++pos;
+        bool negativeExp = false;
+        if (pos != fEnd && (*pos == '-' || *pos == '+'))
+          negativeExp = (*pos++ == '-');
+        if (pos == fEnd || *pos < '0' || *pos > '9')
+          return false;
+        int value = 0;
+        for (; pos != fEnd && *pos >= '0' && *pos <= '9'; ++pos)
+          if (value < 1000) 
+            value = value*10 + (*pos-'0');
+        exponent += (negativeExp ? -value : value);
+      }
+    if (pos != fEnd)
+      return false;
+    double result = double(mantissa);
+    if (mantissa != 0)
+      {
+        if (exponent < -22 || exponent > 22)
+          return false;
+        result = (exponent < 0 ? result/kPow10[-exponent] : result*kPow10[exponent]);
+      }
+    fResult = (negative ? -result : result);
+    return true;
+#else
+    return false;
+#endif
+  }
+  //----------------------------------------------------------------------
+  float getFloat(const char* fBegin, const char* fEnd) 
   {
+    double value;
+    if (getDecimal(fBegin,fEnd,value))
+      return value;
     char* endptr;
-    float result = strtod (token.c_str(), &endptr);
+    float result = strtod (fBegin, &endptr);
+    if (endptr != fBegin && endptr <= fEnd)
+      return result;
+    // not a number, or strtod skipped white space past the token end:
+    // parse a copy of the token as before
+    std::string token(fBegin,fEnd);
+    result = strtod (token.c_str(), &endptr);
     if (endptr == token.c_str()) 
       {
         std::stringstream sserr; 
@@ -32,10 +117,29 @@ namespace
     return result;
   } 
   //----------------------------------------------------------------------
-  unsigned getUnsigned(const std::string& token) 
+  float getFloat(const std::string& token) 
+  {
+    return getFloat(token.c_str(),token.c_str()+token.size());
+  } 
+  //----------------------------------------------------------------------
+  unsigned getUnsigned(const char* fBegin, const char* fEnd) 
   {
+    //---- plain decimal without leading zeros (strtoul reads those as octal)
+    if (fEnd-fBegin > 0 && fEnd-fBegin < 10 && (*fBegin != '0' || fEnd-fBegin == 1))
+      {
+        unsigned value = 0;
+        const char* pos = fBegin;
+        for (; pos != fEnd && *pos >= '0' && *pos <= '9'; ++pos)
+          value = value*10 + (*pos-'0');
+        if (pos == fEnd)
+          return value;
+      }
     char* endptr;
-    unsigned result = strtoul (token.c_str(), &endptr, 0);
+    unsigned result = strtoul (fBegin, &endptr, 0);
+    if (endptr != fBegin && endptr <= fEnd)
+      return result;
+    std::string token(fBegin,fEnd);
+    result = strtoul (token.c_str(), &endptr, 0);
     if (endptr == token.c_str()) 
       {
         std::stringstream sserr; 
@@ -45,6 +149,11 @@ namespace
     return result;
   }
   //----------------------------------------------------------------------
+  unsigned getUnsigned(const std::string& token) 
+  {
+    return getUnsigned(token.c_str(),token.c_str()+token.size());
+  }
+  //----------------------------------------------------------------------
   std::string getSection(const std::string& token) 
   {
     size_t iFirst = token.find ('[');
@@ -54,29 +163,51 @@ namespace
     return "";
   }
   //----------------------------------------------------------------------
-  std::vector<std::string> getTokens(const std::string& fLine)
+  //--- splits [fBegin,fEnd) at blanks, up to the first '#' --------------
+  //--- fTokens is cleared but keeps its capacity between lines ----------
+  void getTokens(const char* fBegin, const char* fEnd, std::vector<TokenRange>& fTokens)
   {
-    std::vector<std::string> tokens;
-    std::string currentToken;
-    for (unsigned ipos = 0; ipos < fLine.length (); ++ipos) 
+    fTokens.clear();
+    const char* token = 0;
+    const char* pos = fBegin;
+    for (; pos != fEnd; ++pos) 
       {
-        char c = fLine[ipos];
+        char c = *pos;
         if (c == '#') break; // ignore comments
         else if (c == ' ') 
           { // flush current token if any
-            if (!currentToken.empty()) 
+            if (token) 
               {
-	        tokens.push_back(currentToken);
-	        currentToken.clear();
+                fTokens.push_back(TokenRange(token,pos));
+                token = 0;
               }
           }
-        else
-          currentToken += c;
+        else if (!token)
+          token = pos;
       }
-    if (!currentToken.empty()) tokens.push_back(currentToken); // flush end 
+    if (token) fTokens.push_back(TokenRange(token,pos)); // flush end 
+  }
+  //----------------------------------------------------------------------
+  std::vector<std::string> getTokens(const std::string& fLine)
+  {
+    std::vector<TokenRange> ranges;
+    getTokens(fLine.c_str(),fLine.c_str()+fLine.size(),ranges);
+    std::vector<std::string> tokens;
+    tokens.reserve(ranges.size());
+    for (unsigned i = 0; i < ranges.size(); ++i) 
+      tokens.push_back(std::string(ranges[i].first,ranges[i].second));
     return tokens;
   }
   //---------------------------------------------------------------------- 
+  std::string getDefinitions(const char* fBegin, const char* fEnd) 
+  {
+    const char* iFirst = std::find (fBegin, fEnd, '{');
+    const char* iLast = std::find (fBegin, fEnd, '}');
+    if (iFirst != fEnd && iLast != fEnd && iFirst < iLast)
+      return std::string (iFirst+1, iLast); 
+    return "";
+  }
+  //---------------------------------------------------------------------- 
   std::string getDefinitions(const std::string& token) 
   {
     size_t iFirst = token.find ('{');
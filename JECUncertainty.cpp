@@ -3,7 +3,6 @@
 #include "TFile.h"
 #include "TF1.h"
 #include "TGraph.h"
-#include "Math/BrentRootFinder.h"
 //#include "Math/RootFinderAlgorithms.h"
 
 #include <cmath>
@@ -146,7 +145,8 @@ void JECUncertainty::_InitL1() {
     const char *s = Form("%sWinter14_V0_DATA_L1FastJetPU_%s_pt.txt",d,a);
     //const char *s = Form("%sWinter14_V6_DATA_RC_%s.txt",d,a);
     if (debug) cout << s << endl << flush;
-    JetCorrectorParameters *l1 = new JetCorrectorParameters(s);
+    JetCorrectorParametersRegistry::Handle l1 =
+      JetCorrectorParametersRegistry::instance().get(s);
     vector<JetCorrectorParameters> v;
     v.push_back(*l1);
     _jecL1DTflat = new FactorizedJetCorrector(v);
@@ -155,7 +155,8 @@ void JECUncertainty::_InitL1() {
     const char *s = Form("%sWinter14_V0_MC_L1FastJetPU_%s_pt.txt",d,a);
     //const char *s = Form("%sWinter14_V6_MC_RC_%s.txt",d,a);
     if (debug) cout << s << endl << flush;
-    JetCorrectorParameters *l1 = new JetCorrectorParameters(s);
+    JetCorrectorParametersRegistry::Handle l1 =
+      JetCorrectorParametersRegistry::instance().get(s);
     vector<JetCorrectorParameters> v;
     v.push_back(*l1);
     _jecL1MCflat = new FactorizedJetCorrector(v);
@@ -165,7 +166,8 @@ void JECUncertainty::_InitL1() {
     //const char *s = Form("%sWinter14_V1_DATA_L1FastJet_%s.txt",d,a);
     const char *s = Form("%sWinter14_V6_DATA_L1FastJet_%s.txt",d,a);
     if (debug) cout << s << endl << flush;
-    JetCorrectorParameters *l1 = new JetCorrectorParameters(s);
+    JetCorrectorParametersRegistry::Handle l1 =
+      JetCorrectorParametersRegistry::instance().get(s);
     vector<JetCorrectorParameters> v;
     v.push_back(*l1);
     _jecL1DTpt = new FactorizedJetCorrector(v);
@@ -174,7 +176,8 @@ void JECUncertainty::_InitL1() {
     //const char *s = Form("%sWinter14_V1_MC_L1FastJet_%s.txt",d,a);
     const char *s = Form("%sWinter14_V6_MC_L1FastJet_%s.txt",d,a);
     if (debug) cout << s << endl << flush;
-    JetCorrectorParameters *l1 = new JetCorrectorParameters(s);
+    JetCorrectorParametersRegistry::Handle l1 =
+      JetCorrectorParametersRegistry::instance().get(s);
     vector<JetCorrectorParameters> v;
     v.push_back(*l1);
     _jecL1MCpt = new FactorizedJetCorrector(v);
@@ -184,7 +187,8 @@ void JECUncertainty::_InitL1() {
     //const char *s = Form("%sWinter14_DataMcSF_L1FastJetPU_%s.txt",d,a);
     const char *s = Form("%sWinter14_V6_DataMcSF_L1FastJetPU_%s.txt",d,a);
     if (debug) cout << s << endl << flush;
-    JetCorrectorParameters *l1 = new JetCorrectorParameters(s);
+    JetCorrectorParametersRegistry::Handle l1 =
+      JetCorrectorParametersRegistry::instance().get(s);
     vector<JetCorrectorParameters> v;
     v.push_back(*l1);
     _jecL1sf = new FactorizedJetCorrector(v);
@@ -196,7 +200,8 @@ void JECUncertainty::_InitL1() {
     const char *s = Form("%sWinter14_V0_DATA_L1FastJetPU_%s_pt.txt",d,a);
     //const char *s = Form("%sWinter14_V6_DATA_RC_%s.txt",d,a);
     if (debug) cout << s << endl << flush;
-    JetCorrectorParameters *l1 = new JetCorrectorParameters(s);
+    JetCorrectorParametersRegistry::Handle l1 =
+      JetCorrectorParametersRegistry::instance().get(s);
     vector<JetCorrectorParameters> v;
     v.push_back(*l1);
     _jecL1DTflat_ak5pfchs = new FactorizedJetCorrector(v);
@@ -206,7 +211,8 @@ void JECUncertainty::_InitL1() {
     //const char *s = Form("%sWinter14_V1_DATA_L1FastJet_%s.txt",d,a);
     const char *s = Form("%sWinter14_V6_DATA_L1FastJet_%s.txt",d,a);
     if (debug) cout << s << endl << flush;
-    JetCorrectorParameters *l1 = new JetCorrectorParameters(s);
+    JetCorrectorParametersRegistry::Handle l1 =
+      JetCorrectorParametersRegistry::instance().get(s);
     vector<JetCorrectorParameters> v;
     v.push_back(*l1);
     _jecL1DTpt_ak5pfchs = new FactorizedJetCorrector(v);
@@ -238,22 +244,26 @@ void JECUncertainty::_InitJEC() {
   //s = Form("%sWinter14_V4_DATA_L1FastJet_%s.txt",d,a);
   s = Form("%sWinter14_V6_DATA_L1FastJet_%s.txt",d,a);
   if (debug) cout << s << endl << flush;
-  JetCorrectorParameters *l1 = new JetCorrectorParameters(s);
+  JetCorrectorParametersRegistry::Handle l1 =
+    JetCorrectorParametersRegistry::instance().get(s);
   //s = Form("%sWinter14_V4_DATA_L2Relative_%s.txt",d,a);
   s = Form("%sWinter14_V6_DATA_L2Relative_%s.txt",d,a);
   if (debug) cout << s << endl << flush;
-  JetCorrectorParameters *l2 = new JetCorrectorParameters(s);
+  JetCorrectorParametersRegistry::Handle l2 =
+    JetCorrectorParametersRegistry::instance().get(s);
   //s = Form("%sWinter14_V4_DATA_L3Absolute_%s.txt",d,a);
   s = Form("%sWinter14_V6_DATA_L3Absolute_%s.txt",d,a);
   if (debug) cout << s << endl << flush;
-  JetCorrectorParameters *l3 = new JetCorrectorParameters(s);
+  JetCorrectorParametersRegistry::Handle l3 =
+    JetCorrectorParametersRegistry::instance().get(s);
   // Only one L3Residual derived for now (although we will later clone this)
   //s = Form("%sWinter14_V4_DATA_L2L3Residual_AK5PFchs.txt",d);
   //s = Form("%sWinter14_V6_DATA_L2L3Residual_AK5PFchs.txt",d);
   //s = Form("%sWinter14_V7_DATA_L2L3Residual_AK5PFchs.txt",d);
   s = Form("%sWinter14_V8_DATA_L2L3Residual_%s.txt",d,a);
   if (debug) cout << s << endl << flush;
-  JetCorrectorParameters *l2l3res = new JetCorrectorParameters(s);
+  JetCorrectorParametersRegistry::Handle l2l3res =
+    JetCorrectorParametersRegistry::instance().get(s);
 
   vector<JetCorrectorParameters> v;
   v.push_back(*l1);
@@ -267,7 +277,8 @@ void JECUncertainty::_InitJEC() {
   s = Form("%sWinter14_V0_DATA_L1FastJetPU_%s_pt.txt",d,a);
   //s = Form("%sWinter14_V6_DATA_RC_%s.txt",d,a);
   if (debug) cout << s << endl << flush;
-  JetCorrectorParameters *l1v0 = new JetCorrectorParameters(s);
+  JetCorrectorParametersRegistry::Handle l1v0 =
+    JetCorrectorParametersRegistry::instance().get(s);
 
   vector<JetCorrectorParameters> v0;
   v0.push_back(*l1v0);
@@ -313,7 +324,8 @@ void JECUncertainty::_InitL2Res() {
     //s = Form("%sWinter14_V6_DATA_L2L3Residual_%s.txt.FLAT",d,a);
     s = Form("%sWinter14_V7_DATA_L2L3Residual_%s.txt.FLAT",d,a);
     if (debug) cout << s << endl << flush;
-    JetCorrectorParameters *l2l3res = new JetCorrectorParameters(s);
+    JetCorrectorParametersRegistry::Handle l2l3res =
+      JetCorrectorParametersRegistry::instance().get(s);
     vector<JetCorrectorParameters> v;
     v.push_back(*l2l3res);
     _jecL2ResFlat = new FactorizedJetCorrector(v);
@@ -323,7 +335,8 @@ void JECUncertainty::_InitL2Res() {
     //s = Form("%sWinter14_V6_DATA_L2L3Residual_%s.txt.LOGLIN",d,a);
     s = Form("%sWinter14_V7_DATA_L2L3Residual_%s.txt.LOGLIN",d,a);
     if (debug) cout << s << endl << flush;
-    JetCorrectorParameters *l2l3res = new JetCorrectorParameters(s);
+    JetCorrectorParametersRegistry::Handle l2l3res =
+      JetCorrectorParametersRegistry::instance().get(s);
     vector<JetCorrectorParameters> v;
     v.push_back(*l2l3res);
     _jecL2ResPt = new FactorizedJetCorrector(v);
@@ -334,7 +347,8 @@ void JECUncertainty::_InitL2Res() {
     //s = Form("%sWinter14_V6_DATA_L2L3Residual_%s.txt.JERup",d,a);
     s = Form("%sWinter14_V7_DATA_L2L3Residual_%s.txt.JERup",d,a);
     if (debug) cout << s << endl << flush;
-    JetCorrectorParameters *l2l3res = new JetCorrectorParameters(s);
+    JetCorrectorParametersRegistry::Handle l2l3res =
+      JetCorrectorParametersRegistry::instance().get(s);
     vector<JetCorrectorParameters> v;
     v.push_back(*l2l3res);
     _jecL2jerup = new FactorizedJetCorrector(v);
@@ -344,7 +358,8 @@ void JECUncertainty::_InitL2Res() {
     //s = Form("%sWinter14_V6_DATA_L2L3Residual_%s.txt.JERdown",d,a);
     s = Form("%sWinter14_V7_DATA_L2L3Residual_%s.txt.JERdown",d,a);
     if (debug) cout << s << endl << flush;
-    JetCorrectorParameters *l2l3res = new JetCorrectorParameters(s);
+    JetCorrectorParametersRegistry::Handle l2l3res =
+      JetCorrectorParametersRegistry::instance().get(s);
     vector<JetCorrectorParameters> v;
     v.push_back(*l2l3res);
     _jecL2jerdw = new FactorizedJetCorrector(v);
@@ -355,7 +370,8 @@ void JECUncertainty::_InitL2Res() {
     //s = Form("%sWinter14_V6_DATA_L2L3Residual_%s.txt.STAT",d,a);
     s = Form("%sWinter14_V7_DATA_L2L3Residual_%s.txt.STAT",d,a);
     if (debug) cout << s << endl << flush;
-    JetCorrectorParameters *l2l3res = new JetCorrectorParameters(s);
+    JetCorrectorParametersRegistry::Handle l2l3res =
+      JetCorrectorParametersRegistry::instance().get(s);
     vector<JetCorrectorParameters> v;
     v.push_back(*l2l3res);
     _jecL2stat = new FactorizedJetCorrector(v);
@@ -399,7 +415,8 @@ void JECUncertainty::_InitL3Res() {
 } // _InitL3Res
 
 
-// Solve pTraw from pTprime = pTraw / R(pTraw) using Brent's method
+// Solve pTraw from pTprime = pTraw / R(pTraw) with the corrector's
+// native inversion (bracketed Newton, warm-started per eta)
 // We want to provide JEC uncertainties vs pTprime, not pTraw, but JEC
 // is only available as a function of pTraw
 double JECUncertainty::_Rjet(double pTprime, double eta,
@@ -413,15 +430,10 @@ double JECUncertainty::_Rjet(double pTprime, double eta,
   double rho = _RhoFromMu(mu);
   if (!jec) jec = _jec;
 
-  ResponseFunc f(pTprime,jec,npv,eta,rho,ajet);
-  
-  //ROOT::Math::Roots::Brent brf;
-  ROOT::Math::BrentRootFinder brf;
-  //brf.SetLogScan(true);
-  // Set parameters of the method
-  brf.SetFunction(f,std::max(2.0,0.25*pTprime),std::min(4*pTprime,4000.0));
-  bool found_root = brf.Solve(50,1e-4,1e-5);
-  double pTraw = brf.Root();
+  jec->setJetEta(eta);
+  jec->setJetA(ajet);
+  jec->setRho(rho);
+  double pTraw = jec->getRawPt(pTprime);
   double rjet = pTraw /pTprime;
   jec->setJetPt(pTraw);
   jec->setJetEta(eta);
@@ -429,13 +441,11 @@ double JECUncertainty::_Rjet(double pTprime, double eta,
   jec->setRho(rho);
   double corr = jec->getCorrection();
   if(std::abs((pTraw * corr - pTprime)/pTprime) > 0.001) {
-    std::cout << "NPV:" << npv << "   Brent: status:" << brf.Status() << " " << brf.Iterations() << '\n';
+    std::cout << "NPV:" << npv << '\n';
     std::cout << "R: pTprime:" << pTprime << "  eta:" << eta << " pTraw:" << pTraw << " corr:" << corr 
               << " pTcor:" << corr * pTraw << " rjet*pTprime:" << rjet * pTprime << '\n'; 
   }
   assert(std::abs((pTraw * corr - pTprime)/pTprime) < 0.001);  
-  assert(found_root);
-  assert(brf.Status() == 0);
   /*
   if((eta > 2.6) && (eta < 2.8)) {
     _jec->setJetE(pTprime*cosh(eta)); 
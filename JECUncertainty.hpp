@@ -7,12 +7,12 @@
 #define STANDALONE
 #include "CondFormats/JetMETObjects/interface/FactorizedJetCorrector.h"
 #include "CondFormats/JetMETObjects/interface/JetCorrectorParameters.h"
+#include "CondFormats/JetMETObjects/interface/JetCorrectorParametersRegistry.h"
 #include "CondFormats/JetMETObjects/interface/JetCorrectionUncertainty.h"
 
 #include "ErrorTypes.hpp"
 #include "JetDefs.hpp"
 
-#include "Math/IFunction.h"
 // ROOT (root.cern.ch) modules
 #include "TMatrixD.h"
 #include "TF1.h"
@@ -145,34 +145,6 @@ private:
 
   // scale factor for AK7 offset (jet area R=0.7/R=0.5)
   double _ajet;
-
-  class ResponseFunc : public ROOT::Math::IBaseFunctionOneDim
-  {
-  public:
-    ResponseFunc(double pTprime, FactorizedJetCorrector *jec, int npv, double eta, double rho, double jeta) :
-      ROOT::Math::IBaseFunctionOneDim(),_pTprime(pTprime),_jec(jec),_npv(npv),_eta(eta),_rho(rho),_jeta(jeta) {}
-    
-    double DoEval(double pTraw) const {
-      _jec->setJetPt(pTraw);
-      _jec->setJetEta(_eta); 
-      _jec->setRho(_rho);
-      _jec->setJetA(_jeta);
-      double cor = _jec->getCorrection();
-      //std::cout << "in Brent: pTraw:" << pTraw << "  cor:" << cor << "  dist:" << pTraw * cor - _pTprime << '\n';
-      return pTraw * cor - _pTprime; 
-    }
-    
-    ROOT::Math::IBaseFunctionOneDim* Clone() const {
-      return new ResponseFunc(_pTprime,_jec,_npv,_eta,_rho,_jeta);
-    }
-  private:
-    double _pTprime;
-    FactorizedJetCorrector *_jec;
-    int _npv; // obsolete
-    double _eta;
-    double _rho;
-    double _jeta;
-  };
 };
 
 #endif /* __JECUNCERTAINTY__ */
@@ -0,0 +1,77 @@
+// Purpose: parameter files and jet samples shared by the test and
+//          benchmark macros
+//
+// Included by the macros (like tdrstyle_mod14.C by the drawing macros),
+// so that ACLiC compiles it into each of them as its mk_ driver loads
+// it. The jets are deterministic: jet number i has a log(pt) and an eta
+// scrambled with large primes, so that neighbouring jets fall in
+// different bins, and an area and a rho cycling over their ranges.
+#ifndef JECTESTHELPERS_H
+#define JECTESTHELPERS_H
+
+#include "CondFormats/JetMETObjects/interface/JetCorrectorParameters.h"
+
+#include <cmath>
+#include <string>
+#include <vector>
+
+// The levels of the factorized chain, in the order they are applied
+const char *const jecLevels[] = {"L1FastJet", "L2Relative", "L3Absolute",
+				 "L2L3Residual"};
+const int nJecLevels = sizeof(jecLevels)/sizeof(jecLevels[0]);
+
+// File of one level, e.g. dir/Winter14_V1_DATA_L2Relative_AK5PFchs.txt
+inline std::string jecLevelFile(const std::string& dir,
+				const std::string& version,
+				const std::string& level,
+				const std::string& algo) {
+  return dir + version + "_" + level + "_" + algo + ".txt";
+}
+
+// Parameters of all the levels of the chain
+inline std::vector<JetCorrectorParameters>
+loadJecLevels(const std::string& dir, const std::string& version,
+	      const std::string& algo) {
+
+  std::vector<JetCorrectorParameters> vpar;
+  for (int i = 0; i != nJecLevels; ++i)
+    vpar.push_back(JetCorrectorParameters
+		   (jecLevelFile(dir, version, jecLevels[i], algo)));
+  return vpar;
+}
+
+// Jet number i of the sample: pt 10-3000 GeV, |eta| up to 5.1 (past the
+// last bins), area 0.4-0.6 and rho 2-30 GeV
+inline float samplePt(long i) {
+  return 10.*std::pow(300., double((i*7919) % 99991)/99990);
+}
+inline float sampleEta(long i) {
+  return -5.1 + 10.2*((i*104729) % 100003)/100002.;
+}
+inline float sampleArea(long i) { return 0.4 + 0.2*((i*31) % 11)/10.; }
+inline float sampleRho(long i)  { return 2. + 28.*((i*37) % 101)/100.; }
+
+// Value of a binning or parameter variable for jet number i
+inline float sampleVariable(const std::string& name, long i) {
+
+  if (name == "JetPt")  return samplePt(i);
+  if (name == "JetEta") return sampleEta(i);
+  if (name == "JetA")   return sampleArea(i);
+  if (name == "Rho")    return sampleRho(i);
+  return 0;
+}
+
+// The first njet jets of the sample, as columns
+struct JetSample {
+  std::vector<float> mPt, mEta, mArea, mRho;
+  explicit JetSample(int njet) {
+    for (int i = 0; i != njet; ++i) {
+      mPt.push_back(samplePt(i));
+      mEta.push_back(sampleEta(i));
+      mArea.push_back(sampleArea(i));
+      mRho.push_back(sampleRho(i));
+    }
+  }
+};
+
+#endif